@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace expr {
+
+// Bump allocator for scratch memory that dies all at once. Memory is carved
+// from blocks that are kept across `Reset`, so once the arena has grown to
+// the largest working set it never allocates again.
+class Arena {
+  public:
+	explicit Arena(size_t block_size = 4096) : block_size(block_size) {}
+
+	// Uninitialized room for `n` objects of T. Nothing is ever destroyed, so
+	// T must be trivially destructible.
+	template <typename T> T *Allocate(size_t n) {
+		static_assert(std::is_trivially_destructible_v<T>);
+		return static_cast<T *>(Allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void *Allocate(size_t size, size_t align) {
+		while (true) {
+			if (current < blocks.size()) {
+				size_t offset = (used + align - 1) & ~(align - 1);
+				if (offset + size <= blocks[current].size) {
+					used = offset + size;
+					return blocks[current].data.get() + offset;
+				}
+				// Too small: move on, to an already allocated block if any.
+				++current;
+				used = 0;
+				continue;
+			}
+			// Blocks double in size so that a growing arena allocates
+			// O(log n) times.
+			size_t block = std::max(block_size, size + align);
+			if (!blocks.empty()) {
+				block = std::max(block, 2 * blocks.back().size);
+			}
+			blocks.push_back(
+				Block{std::make_unique_for_overwrite<std::byte[]>(block), block});
+		}
+	}
+
+	// Free everything allocated so far in O(1), keeping the blocks.
+	void Reset() {
+		current = 0;
+		used = 0;
+	}
+
+	// Bytes held by the arena, whether in use or not.
+	size_t Capacity() const {
+		size_t capacity = 0;
+		for (const Block &block : blocks) {
+			capacity += block.size;
+		}
+		return capacity;
+	}
+
+  private:
+	struct Block {
+		std::unique_ptr<std::byte[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t current = 0; // Block allocations are carved from.
+	size_t used = 0;	// Bytes used in the current block.
+	size_t block_size;
+};
+
+// Vector whose capacity is fixed when it is allocated from an arena. It
+// serves where an upper bound on the size is known up front, and is
+// released with the arena.
+template <typename T> class FixedVector {
+  public:
+	FixedVector() = default;
+	FixedVector(Arena &arena, size_t capacity)
+		: first(arena.Allocate<T>(capacity)), count(0), capacity(capacity) {}
+
+	T *begin() { return first; }
+	T *end() { return first + count; }
+	const T *begin() const { return first; }
+	const T *end() const { return first + count; }
+	T *data() { return first; }
+	const T *data() const { return first; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	T &operator[](size_t i) { return first[i]; }
+	const T &operator[](size_t i) const { return first[i]; }
+	T &back() { return first[count - 1]; }
+	const T &back() const { return first[count - 1]; }
+
+	void push_back(const T &value) {
+		assert(count < capacity);
+		new (first + count++) T(value);
+	}
+	// Grow or shrink to `n` elements. New ones are left uninitialized.
+	void resize(size_t n) {
+		assert(n <= capacity);
+		count = n;
+	}
+	void clear() { count = 0; }
+
+  private:
+	T *first = nullptr;
+	size_t count = 0;
+	size_t capacity = 0;
+};
+
+} // namespace expr
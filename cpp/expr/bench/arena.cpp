@@ -0,0 +1,102 @@
+// Heap allocations and time per evaluation with scratch buffers allocated
+// afresh for every expression, against a Context whose arena is reset
+// between expressions.
+#include "cache.h"
+#include "expr.h"
+#include "generate.h"
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+	++allocations;
+	if (void *p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+struct Result {
+	double allocations; // Per evaluation.
+	double ns;			// Per evaluation.
+};
+
+template <typename Func>
+static Result measure(const std::vector<std::string> &formulas, int rounds,
+					  Func &&func) {
+	for (const auto &formula : formulas) {
+		func(formula); // Warm up and let scratch buffers grow.
+	}
+	size_t before = allocations;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; ++i) {
+		for (const auto &formula : formulas) {
+			func(formula);
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	double count = static_cast<double>(rounds) * formulas.size();
+	return Result{(allocations - before) / count,
+				  std::chrono::duration<double, std::nano>(end - start).count() /
+					  count};
+}
+
+int main() {
+	std::mt19937 rng(42);
+	long sink = 0;
+
+	std::cout << std::format("{:>8} {:>22} {:>22} {:>22}\n", "tokens",
+							 "fresh (allocs, ns)", "arena (allocs, ns)",
+							 "cache hit (allocs, ns)");
+	for (size_t target : {10, 100, 1000}) {
+		std::vector<std::string> formulas;
+		for (int i = 0; i < 100; ++i) {
+			formulas.push_back(make_expression(rng, target, 8, true));
+		}
+		int rounds = static_cast<int>(100000 / target);
+
+		Result fresh = measure(formulas, rounds, [&](const auto &formula) {
+			std::vector<expr::Token> tokens;
+			std::vector<expr::Node> nodes;
+			std::vector<int64_t> values;
+			size_t pos;
+			int64_t result = 0;
+			if (expr::make_token(formula, tokens, pos) &&
+				expr::parse(tokens, nodes)) {
+				expr::eval(nodes, values, result);
+			}
+			sink += result;
+		});
+
+		expr::Context ctx;
+		Result arena = measure(formulas, rounds, [&](const auto &formula) {
+			int64_t result = 0;
+			expr::evaluate(formula, ctx, result);
+			sink += result;
+		});
+
+		expr::ProgramCache cache(formulas.size());
+		Result cached = measure(formulas, rounds, [&](const auto &formula) {
+			int64_t result = 0;
+			expr::evaluate(formula, ctx, cache, result);
+			sink += result;
+		});
+
+		std::cout << std::format(
+			"{:>8} {:>12.2f} {:>9.1f} {:>12.2f} {:>9.1f} {:>12.2f} {:>9.1f}\n",
+			target, fresh.allocations, fresh.ns, arena.allocations, arena.ns,
+			cached.allocations, cached.ns);
+	}
+	std::cout << std::format("(sink {})\n", sink);
+	return 0;
+}
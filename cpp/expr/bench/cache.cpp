@@ -0,0 +1,141 @@
+// Hit rate and end-to-end latency of evaluating expression text through the
+// compiled-expression cache, for several capacities, on a workload drawing
+// formulas from a Zipf distribution.
+#include "bigint.h"
+#include "cache.h"
+#include "expr.h"
+#include "generate.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Indices in [0, n) where index i is drawn with weight 1 / (i + 1)^s.
+static std::vector<size_t> zipf(std::mt19937 &rng, size_t n, double s,
+								size_t count) {
+	std::vector<double> cdf(n);
+	double sum = 0;
+	for (size_t i = 0; i < n; ++i) {
+		sum += 1 / std::pow(i + 1, s);
+		cdf[i] = sum;
+	}
+	std::uniform_real_distribution<double> pick(0, sum);
+	std::vector<size_t> indices(count);
+	for (auto &index : indices) {
+		index = std::lower_bound(cdf.begin(), cdf.end(), pick(rng)) -
+				cdf.begin();
+		index = std::min(index, n - 1);
+	}
+	return indices;
+}
+
+struct Latency {
+	double mean, p50, p99;
+};
+
+// Evaluate the `workload` formulas in order, timing each evaluation.
+template <typename Func>
+static Latency measure(const std::vector<std::string> &formulas,
+					   const std::vector<size_t> &workload, Func &&func) {
+	std::vector<double> samples;
+	samples.reserve(workload.size());
+	for (size_t index : workload) {
+		auto start = std::chrono::steady_clock::now();
+		func(formulas[index]);
+		auto end = std::chrono::steady_clock::now();
+		samples.push_back(
+			std::chrono::duration<double, std::nano>(end - start).count());
+	}
+	double sum = 0;
+	for (double sample : samples) {
+		sum += sample;
+	}
+	std::sort(samples.begin(), samples.end());
+	return Latency{sum / samples.size(), samples[samples.size() / 2],
+				   samples[samples.size() * 99 / 100]};
+}
+
+int main(int argc, char *argv[]) {
+	size_t distinct = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+	double skew = argc > 2 ? std::strtod(argv[2], nullptr) : 1.0;
+	constexpr size_t kEvaluations = 1000000;
+
+	std::mt19937 rng(42);
+	std::vector<std::string> formulas;
+	for (size_t i = 0; i < distinct; ++i) {
+		formulas.push_back(make_expression(rng, 10 + rng() % 40, 8, true));
+	}
+	std::vector<size_t> workload = zipf(rng, distinct, skew, kEvaluations);
+	std::cout << std::format("{} evaluations of {} distinct formulas, "
+							 "Zipf skew {}\n",
+							 kEvaluations, distinct, skew);
+
+	long sink = 0;
+	expr::Context ctx;
+	std::vector<int64_t> expected(distinct);
+	for (size_t i = 0; i < distinct; ++i) {
+		if (expr::evaluate(formulas[i], ctx, expected[i]) != expr::Status::Ok) {
+			std::cerr << "failed to evaluate: " << formulas[i] << std::endl;
+			return 1;
+		}
+	}
+	// Literals just out of 64-bit range overflow, cached or not, and are
+	// left to the bigint fallback.
+	expr::ProgramCache check_cache(1);
+	for (std::string_view e : {"9223372036854775808", "-9223372036854775808"}) {
+		int64_t result;
+		expr::BigInt big;
+		if (expr::evaluate(e, ctx, result) != expr::Status::Overflow ||
+			expr::evaluate(e, ctx, check_cache, result) !=
+				expr::Status::Overflow ||
+			expr::evaluate_big(e, ctx, big) != expr::Status::Ok ||
+			big.ToString() != e) {
+			std::cerr << "failed to evaluate: " << e << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << std::format("{:>10} {:>10} {:>12} {:>12} {:>12}\n", "capacity",
+							 "hit rate", "mean (ns)", "p50 (ns)", "p99 (ns)");
+	Latency uncached = measure(formulas, workload, [&](const auto &formula) {
+		int64_t result;
+		expr::evaluate(formula, ctx, result);
+		sink += result;
+	});
+	std::cout << std::format("{:>10} {:>10} {:>12.1f} {:>12.1f} {:>12.1f}\n",
+							 "none", "-", uncached.mean, uncached.p50,
+							 uncached.p99);
+
+	for (size_t capacity : {64, 256, 1024, 4096}) {
+		expr::ProgramCache cache(capacity);
+		bool ok = true;
+		Latency cached = measure(formulas, workload, [&](const auto &formula) {
+			int64_t result;
+			expr::evaluate(formula, ctx, cache, result);
+			sink += result;
+		});
+		double hit_rate =
+			static_cast<double>(cache.Hits()) / (cache.Hits() + cache.Misses());
+		// Check the cached results after timing, on a second pass.
+		for (size_t index : workload) {
+			int64_t result;
+			expr::evaluate(formulas[index], ctx, cache, result);
+			ok = ok && result == expected[index];
+		}
+		if (!ok) {
+			std::cerr << "cached evaluation disagrees" << std::endl;
+			return 1;
+		}
+		std::cout << std::format(
+			"{:>10} {:>9.1f}% {:>12.1f} {:>12.1f} {:>12.1f}\n", capacity,
+			100 * hit_rate, cached.mean, cached.p50, cached.p99);
+	}
+	std::cout << std::format("(sink {})\n", sink);
+	return 0;
+}
@@ -0,0 +1,202 @@
+// Rows per second of columnar evaluation, with and without SIMD kernels,
+// against a row-at-a-time interpreter running the same bytecode.
+#include "column.h"
+#include "lexer.h"
+#include "parser.h"
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using expr::Column;
+using expr::ColumnType;
+
+// A value of either column type, as a row-at-a-time interpreter sees it.
+struct Value {
+	ColumnType type;
+	int64_t i;
+	double f;
+};
+
+static Value to_float(Value v) {
+	return v.type == ColumnType::Float
+			   ? v
+			   : Value{ColumnType::Float, 0, static_cast<double>(v.i)};
+}
+
+static bool apply(expr::Op op, Value a, Value b, Value &out) {
+	using expr::Op;
+	if (a.type != b.type) {
+		a = to_float(a);
+		b = to_float(b);
+	}
+	if (op == Op::Eq) {
+		out = Value{ColumnType::Int,
+					a.type == ColumnType::Int ? a.i == b.i : a.f == b.f, 0};
+		return true;
+	}
+	if (a.type == ColumnType::Float) {
+		double f = op == Op::Neg   ? -a.f
+				   : op == Op::Add ? a.f + b.f
+				   : op == Op::Sub ? a.f - b.f
+				   : op == Op::Mul ? a.f * b.f
+								   : a.f / b.f;
+		out = Value{ColumnType::Float, 0, f};
+		return true;
+	}
+	uint64_t x = a.i, y = b.i;
+	int64_t i;
+	switch (op) {
+	case Op::Neg:
+		i = static_cast<int64_t>(0 - x);
+		break;
+	case Op::Add:
+		i = static_cast<int64_t>(x + y);
+		break;
+	case Op::Sub:
+		i = static_cast<int64_t>(x - y);
+		break;
+	case Op::Mul:
+		i = static_cast<int64_t>(x * y);
+		break;
+	default:
+		if (b.i == 0) {
+			return false;
+		}
+		i = b.i == -1 ? static_cast<int64_t>(0 - x) : a.i / b.i;
+		break;
+	}
+	out = Value{ColumnType::Int, i, 0};
+	return true;
+}
+
+// Run `program` once per row on tagged values.
+static bool eval_rows(const expr::Program &program,
+					  const std::vector<Column> &inputs, size_t rows,
+					  expr::ColumnResult &result) {
+	std::vector<Value> stack(program.max_stack);
+	result.ints.clear();
+	result.floats.clear();
+	for (size_t row = 0; row < rows; ++row) {
+		Value *sp = stack.data();
+		for (const expr::Instr &instr : program.code) {
+			switch (instr.op) {
+			case expr::Op::Push:
+				*sp++ = Value{ColumnType::Int, instr.operand, 0};
+				break;
+			case expr::Op::Load: {
+				const Column &column = inputs[instr.operand];
+				if (column.type == ColumnType::Int) {
+					*sp++ = Value{ColumnType::Int,
+								  static_cast<const int64_t *>(column.data)[row],
+								  0};
+				} else {
+					*sp++ = Value{ColumnType::Float, 0,
+								  static_cast<const double *>(column.data)[row]};
+				}
+				break;
+			}
+			case expr::Op::Neg:
+				if (!apply(instr.op, sp[-1], sp[-1], sp[-1])) {
+					return false;
+				}
+				break;
+			default:
+				if (!apply(instr.op, sp[-2], sp[-1], sp[-2])) {
+					return false;
+				}
+				--sp;
+				break;
+			}
+		}
+		result.type = stack[0].type;
+		if (stack[0].type == ColumnType::Int) {
+			result.ints.push_back(stack[0].i);
+		} else {
+			result.floats.push_back(stack[0].f);
+		}
+	}
+	return true;
+}
+
+template <typename Func> static double rows_per_second(size_t rows,
+													   Func &&func) {
+	func(); // Warm up caches and grow buffers.
+	constexpr int kRounds = 5;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < kRounds; ++i) {
+		func();
+	}
+	auto end = std::chrono::steady_clock::now();
+	return kRounds * rows / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+	size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+	std::mt19937_64 rng(42);
+	std::vector<int64_t> a(rows), b(rows), c(rows);
+	std::vector<double> x(rows), y(rows), z(rows);
+	for (size_t i = 0; i < rows; ++i) {
+		a[i] = static_cast<int64_t>(rng() % 2000000) - 1000000;
+		b[i] = static_cast<int64_t>(rng() % 2000000) - 1000000;
+		c[i] = static_cast<int64_t>(rng() % 1000) + 1;
+		x[i] = static_cast<double>(rng() % 1000000) / 7;
+		y[i] = static_cast<double>(rng() % 1000000) / 3;
+		z[i] = static_cast<double>(rng() % 1000) + 1;
+	}
+	std::map<std::string, Column, std::less<>> columns{
+		{"a", Column{ColumnType::Int, a.data()}},
+		{"b", Column{ColumnType::Int, b.data()}},
+		{"c", Column{ColumnType::Int, c.data()}},
+		{"x", Column{ColumnType::Float, x.data()}},
+		{"y", Column{ColumnType::Float, y.data()}},
+		{"z", Column{ColumnType::Float, z.data()}},
+	};
+
+	std::cout << std::format("{} rows, Mrows/s\n", rows);
+	std::cout << std::format("{:<24} {:>10} {:>10} {:>10}\n", "formula",
+							 "row", "column", "simd");
+	for (const char *formula :
+		 {"a * 3 + b / c", "a + b - c * 2 == a", "x * 3 + y / z",
+		  "-(x - y) * (x + y) / z", "a * 3 + x / c"}) {
+		std::vector<expr::Token> tokens;
+		std::vector<expr::Node> nodes;
+		expr::Program program;
+		size_t pos;
+		if (!expr::make_token(formula, tokens, pos) ||
+			!expr::parse(tokens, nodes)) {
+			std::cerr << "bad formula: " << formula << std::endl;
+			return 1;
+		}
+		expr::compile(nodes, program);
+		std::vector<Column> inputs;
+		for (const auto &name : program.variables) {
+			inputs.push_back(columns.at(name));
+		}
+
+		expr::ColumnResult row_result, column_result, simd_result;
+		double row = rows_per_second(rows, [&]() {
+			eval_rows(program, inputs, rows, row_result);
+		});
+		double column = rows_per_second(rows, [&]() {
+			expr::eval_columns(program, columns, rows, column_result, false);
+		});
+		double simd = rows_per_second(rows, [&]() {
+			expr::eval_columns(program, columns, rows, simd_result);
+		});
+		if (row_result.ints != column_result.ints ||
+			row_result.floats != column_result.floats ||
+			row_result.ints != simd_result.ints ||
+			row_result.floats != simd_result.floats) {
+			std::cerr << "results disagree on: " << formula << std::endl;
+			return 1;
+		}
+		std::cout << std::format("{:<24} {:>10.1f} {:>10.1f} {:>10.1f}\n",
+								 formula, row / 1e6, column / 1e6, simd / 1e6);
+	}
+	return 0;
+}
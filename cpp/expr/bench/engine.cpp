@@ -0,0 +1,135 @@
+// Regression benchmark of the expr engine: lexing, parsing and evaluation
+// timed separately on random expressions of controlled size and nesting
+// depth, reported in ns/token and throughput.
+//
+// Usage: engine [--tokens 10,100,1000] [--depth 2,8] [--count <n>]
+//               [--rounds <n>]
+//
+// Every combination of --tokens and --depth is run on --count expressions.
+// Each phase is timed --rounds times over all of them, keeping the fastest
+// round to filter out noise.
+#include "generate.h"
+#include "lexer.h"
+#include "parser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static std::vector<size_t> parse_list(std::string_view list) {
+	std::vector<size_t> values;
+	while (!list.empty()) {
+		size_t comma = list.find(',');
+		std::string value(list.substr(0, comma));
+		values.push_back(std::strtoul(value.c_str(), nullptr, 10));
+		list.remove_prefix(comma == std::string_view::npos ? list.size()
+														   : comma + 1);
+	}
+	return values;
+}
+
+// Fastest of `rounds` runs of `func`, in nanoseconds.
+template <typename Func> static double best_ns(int rounds, Func &&func) {
+	double best = std::numeric_limits<double>::max();
+	for (int i = 0; i < rounds; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		func();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(
+			best, std::chrono::duration<double, std::nano>(end - start).count());
+	}
+	return best;
+}
+
+int main(int argc, char *argv[]) {
+	std::vector<size_t> sizes = {10, 100, 1000};
+	std::vector<size_t> depths = {2, 8};
+	size_t count = 1000;
+	int rounds = 5;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string_view arg = argv[i];
+		if (arg == "--tokens") {
+			sizes = parse_list(argv[i + 1]);
+		} else if (arg == "--depth") {
+			depths = parse_list(argv[i + 1]);
+		} else if (arg == "--count") {
+			count = std::strtoul(argv[i + 1], nullptr, 10);
+		} else if (arg == "--rounds") {
+			rounds = std::atoi(argv[i + 1]);
+		} else {
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << std::format(
+		"{:>7} {:>6} {:>9} {:>12} {:>12} {:>12} {:>12} {:>10} {:>10}\n",
+		"target", "depth", "tokens", "lex ns/tok", "parse ns/tok",
+		"eval ns/tok", "sum ns/tok", "Mtok/s", "Kexpr/s");
+	std::mt19937 rng(42);
+	int64_t sink = 0;
+	for (size_t depth : depths) {
+		for (size_t size : sizes) {
+			std::vector<std::string> formulas;
+			for (size_t i = 0; i < count; ++i) {
+				formulas.push_back(
+					make_expression(rng, size, static_cast<int>(depth), true));
+			}
+
+			// Keep every phase's output so that each can be timed on its
+			// own, from the previous phase's results.
+			std::vector<std::vector<expr::Token>> tokens(count);
+			std::vector<std::vector<expr::Node>> nodes(count);
+			std::vector<int64_t> values;
+			size_t total = 0;
+			for (size_t i = 0; i < count; ++i) {
+				size_t pos;
+				int64_t result;
+				if (!expr::make_token(formulas[i], tokens[i], pos) ||
+					!expr::parse(tokens[i], nodes[i]) ||
+					expr::eval(nodes[i], values, result) ==
+						expr::Status::Failed) {
+					std::cerr << "failed to evaluate: " << formulas[i]
+							  << std::endl;
+					return 1;
+				}
+				total += tokens[i].size();
+			}
+
+			double lex = best_ns(rounds, [&]() {
+				for (size_t i = 0; i < count; ++i) {
+					size_t pos;
+					expr::make_token(formulas[i], tokens[i], pos);
+				}
+			});
+			double parse = best_ns(rounds, [&]() {
+				for (size_t i = 0; i < count; ++i) {
+					sink += expr::parse(tokens[i], nodes[i]);
+				}
+			});
+			double eval = best_ns(rounds, [&]() {
+				for (size_t i = 0; i < count; ++i) {
+					int64_t result;
+					expr::eval(nodes[i], values, result);
+					sink += result;
+				}
+			});
+
+			double all = lex + parse + eval;
+			std::cout << std::format(
+				"{:>7} {:>6} {:>9} {:>12.2f} {:>12.2f} {:>12.2f} {:>12.2f} "
+				"{:>10.2f} {:>10.1f}\n",
+				size, depth, total, lex / total, parse / total, eval / total,
+				all / total, total / all * 1e3, count / all * 1e6);
+		}
+	}
+	std::cout << std::format("(sink {})\n", sink);
+	return 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// Random expressions for the benchmarks.
+
+#include <random>
+#include <string>
+
+// Random expression of about `target` tokens with brackets nested at most
+// `max_depth` deep. Divisors are always non-zero literals, so it never
+// fails. With `negations`, some operands are negated; the original
+// evaluator in legacy.h does not implement negation.
+inline std::string make_expression(std::mt19937 &rng, size_t target,
+								   int max_depth = 8, bool negations = false) {
+	std::uniform_int_distribution<int> pick(0, 99);
+	std::string s;
+	size_t count = 0;
+	int open = 0;
+	bool literal_only = false;
+	while (true) {
+		if (negations && !literal_only && pick(rng) < 10) {
+			s += "-";
+			++count;
+		}
+		if (!literal_only && open < max_depth && pick(rng) < 15) {
+			s += "(";
+			++open;
+			++count;
+			continue;
+		}
+		s += std::to_string(1 + pick(rng) % 9);
+		++count;
+		literal_only = false;
+		while (open > 0 && (pick(rng) < 30 || count >= target)) {
+			s += ")";
+			--open;
+			++count;
+		}
+		if (count >= target) {
+			break;
+		}
+		char op = "+-*/"[pick(rng) % 4];
+		s += op;
+		++count;
+		literal_only = op == '/';
+	}
+	return s;
+}
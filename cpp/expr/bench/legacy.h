@@ -0,0 +1,214 @@
+#pragma once
+
+// The original std::regex tokenizer and recursive evaluator of expr.cpp,
+// kept as the baseline for the benchmarks.
+
+#include "lexer.h"
+#include <charconv>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace legacy {
+
+struct Token {
+	int type;
+	std::string str;
+};
+
+static struct rule {
+	std::regex regex;
+	int token_type;
+} rules[] = {
+	{std::regex(" +"), expr::TK_NOTYPE},			 // spaces
+	{std::regex("\\+"), '+'},						 // plus
+	{std::regex("-"), '-'},							 // minus
+	{std::regex("\\*"), '*'},						 // multiply
+	{std::regex("\\/"), '/'},						 // divide
+	{std::regex("\\("), '('},						 // left bracket
+	{std::regex("\\)"), ')'},						 // right bracket
+	{std::regex("=="), expr::TK_EQ},				 // equal
+	{std::regex("0[0-7]+"), expr::TK_OCT},			 // octal
+	{std::regex("0[xX][0-9a-fA-F]+"), expr::TK_HEX}, // hex
+	{std::regex("0|^[1-9][0-9]*"), expr::TK_DEC},	 // decimal
+};
+
+static size_t NR_REGEX = sizeof(rules) / sizeof(rules[0]);
+
+inline bool make_token(const std::string e, std::vector<Token> &tokens) {
+	auto position = e.begin();
+	size_t i;
+
+	while (position != e.end()) {
+		std::smatch match;
+		/* Try all rules one by one. */
+		for (i = 0; i < NR_REGEX; i++) {
+			if (std::regex_search(position, e.end(), match, rules[i].regex,
+								  std::regex_constants::match_continuous)) {
+				int type = rules[i].token_type;
+				if (type == expr::TK_NOTYPE) {
+					position += match[0].length();
+					break;
+				} else if (type == '-') {
+					if (tokens.size() == 0 ||
+						(tokens.back().type != expr::TK_DEC &&
+						 tokens.back().type != expr::TK_OCT &&
+						 tokens.back().type != expr::TK_HEX &&
+						 tokens.back().type != ')')) {
+						type = expr::TK_NEG;
+					}
+				}
+				tokens.emplace_back(Token{type, match[0]});
+				position += match[0].length();
+				break;
+			}
+		}
+
+		if (i == NR_REGEX) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename T1, typename T2> inline bool notin(T1 first, T2 second) {
+	return first != second;
+}
+
+template <typename T1, typename T2, typename... Args>
+inline bool notin(T1 first, T2 second, Args... others) {
+	return first != second && notin(first, others...);
+}
+
+// Parse a literal token. Fails instead of wrapping if it does not fit.
+inline int parse_literal(const expr::Token &token, bool &expr_success) {
+	std::string_view digits = token.str;
+	int base = 10;
+	if (token.type == expr::TK_OCT) {
+		base = 8;
+	} else if (token.type == expr::TK_HEX) {
+		base = 16;
+		digits.remove_prefix(2);
+	}
+	int value = 0;
+	auto [end, ec] = std::from_chars(digits.data(),
+									 digits.data() + digits.size(), value, base);
+	if (ec != std::errc() || end != digits.data() + digits.size()) {
+		expr_success = false;
+		return 0;
+	}
+	return value;
+}
+
+inline bool check_parenthese(const std::vector<expr::Token> &tokens, int l,
+							 int r, bool &expr_success) {
+	if (tokens[l].type != '(' || tokens[r].type != ')') {
+		return false;
+	}
+	int i = l + 1, cnt = 1;
+	while (i < r) {
+		if (tokens[i].type == '(') {
+			cnt++;
+		} else if (tokens[i].type == ')') {
+			cnt--;
+		}
+		if (cnt == 0) {
+			return false;
+		}
+		i++;
+	}
+
+	if (cnt != 1) {
+		expr_success = false;
+		return false;
+	}
+
+	return true;
+}
+
+inline int eval(const std::vector<expr::Token> &tokens, int l, int r,
+				bool &expr_success) {
+	if (l > r) {
+		return 0;
+	} else if (l == r) {
+		switch (tokens[l].type) {
+		case expr::TK_DEC:
+		case expr::TK_OCT:
+		case expr::TK_HEX:
+			return parse_literal(tokens[l], expr_success);
+		default:
+			expr_success = false;
+			return 0;
+		}
+	} else if (check_parenthese(tokens, l, r, expr_success)) {
+		return eval(tokens, l + 1, r - 1, expr_success);
+	} else {
+		int op_pos = l, main_op_pos = l;
+		for (; op_pos <= r; ++op_pos) {
+			switch (tokens[op_pos].type) {
+			case '+':
+			case '-':
+				main_op_pos = op_pos;
+				break;
+			case '*':
+			case '/':
+				if (notin(tokens[main_op_pos].type, '+', '-')) {
+					main_op_pos = op_pos;
+				}
+				break;
+			case expr::TK_NEG:
+				if (notin(tokens[main_op_pos].type, '+', '-', '*', '/')) {
+					main_op_pos = op_pos;
+				}
+				break;
+			case '(': {
+				int cnt = 1;
+				op_pos++;
+				while (op_pos <= r) {
+					if (tokens[op_pos].type == '(') {
+						cnt++;
+					} else if (tokens[op_pos].type == ')') {
+						cnt--;
+					}
+					op_pos++;
+					if (cnt == 0) {
+						op_pos--;
+						break;
+					}
+				}
+			}
+			default:
+				break;
+			}
+		}
+
+		if (notin(tokens[main_op_pos].type, expr::TK_NEG, '+', '-', '*', '/')) {
+			expr_success = false;
+			return 0;
+		}
+		int lhs = eval(tokens, l, main_op_pos - 1, expr_success);
+		if (!expr_success)
+			return 0;
+		int rhs = eval(tokens, main_op_pos + 1, r, expr_success);
+		if (!expr_success)
+			return 0;
+
+		switch (tokens[main_op_pos].type) {
+		case '+':
+			return lhs + rhs;
+		case '-':
+			return lhs - rhs;
+		case '*':
+			return lhs * rhs;
+		case '/':
+			if (rhs == 0) {
+				expr_success = false;
+				return 0;
+			}
+			return lhs / rhs;
+		}
+	}
+	return 0;
+}
+
+} // namespace legacy
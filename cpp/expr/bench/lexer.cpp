@@ -0,0 +1,110 @@
+// Tokenizer throughput of the hand-written lexer against the original
+// std::regex tokenizer on formulas of a few dozen tokens each.
+#include "legacy.h"
+#include "lexer.h"
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Random formula mixing every literal kind, negation and nested brackets.
+static std::string make_formula(std::mt19937 &rng, int depth) {
+	std::uniform_int_distribution<int> pick(0, 9);
+	std::string s;
+	int terms = 2 + pick(rng) % 4;
+	for (int t = 0; t < terms; ++t) {
+		if (t > 0) {
+			s += std::string(" ") + "+-*/"[pick(rng) % 4] + " ";
+		}
+		int kind = pick(rng);
+		if (kind == 0) {
+			s += "-";
+		}
+		if (kind < 3 && depth > 0) {
+			s += "(" + make_formula(rng, depth - 1) + ")";
+		} else if (kind < 5) {
+			s += std::to_string(rng() % 100000);
+		} else if (kind < 7) {
+			s += std::format("0x{:x}", rng() % 65536);
+		} else if (kind < 8) {
+			s += std::format("0{:o}", 1 + rng() % 4096);
+		} else {
+			s += std::to_string(rng() % 10);
+		}
+	}
+	return s;
+}
+
+template <typename Func> static double elapsed_ns(Func &&func) {
+	auto start = std::chrono::steady_clock::now();
+	func();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+	int count = argc > 1 ? std::atoi(argv[1]) : 10000;
+
+	std::mt19937 rng(42);
+	std::vector<std::string> formulas;
+	for (int i = 0; i < count; ++i) {
+		formulas.push_back(make_formula(rng, 2));
+	}
+
+	// Both tokenizers must agree before their speed means anything.
+	std::vector<expr::Token> tokens;
+	std::vector<legacy::Token> legacy_tokens;
+	size_t total_tokens = 0;
+	for (const auto &formula : formulas) {
+		size_t pos;
+		legacy_tokens.clear();
+		if (!expr::make_token(formula, tokens, pos) ||
+			!legacy::make_token(formula, legacy_tokens) ||
+			tokens.size() != legacy_tokens.size()) {
+			std::cerr << "tokenizers disagree on: " << formula << std::endl;
+			return 1;
+		}
+		for (size_t i = 0; i < tokens.size(); ++i) {
+			if (tokens[i].type != legacy_tokens[i].type ||
+				tokens[i].str != legacy_tokens[i].str) {
+				std::cerr << "tokenizers disagree on: " << formula << std::endl;
+				return 1;
+			}
+		}
+		total_tokens += tokens.size();
+	}
+
+	size_t checksum = 0;
+	double lexer_ns = elapsed_ns([&]() {
+		for (int round = 0; round < 100; ++round) {
+			for (const auto &formula : formulas) {
+				size_t pos;
+				expr::make_token(formula, tokens, pos);
+				checksum += tokens.size();
+			}
+		}
+	}) / 100;
+	double regex_ns = elapsed_ns([&]() {
+		for (const auto &formula : formulas) {
+			legacy_tokens.clear();
+			legacy::make_token(formula, legacy_tokens);
+			checksum += legacy_tokens.size();
+		}
+	});
+
+	std::cout << std::format("{} formulas, {} tokens (checksum {})\n", count,
+							 total_tokens, checksum);
+	std::cout << std::format("{:<10} {:>12} {:>14}\n", "tokenizer", "ns/token",
+							 "Mtokens/s");
+	std::cout << std::format("{:<10} {:>12.2f} {:>14.2f}\n", "regex",
+							 regex_ns / total_tokens,
+							 total_tokens / regex_ns * 1e3);
+	std::cout << std::format("{:<10} {:>12.2f} {:>14.2f}\n", "lexer",
+							 lexer_ns / total_tokens,
+							 total_tokens / lexer_ns * 1e3);
+	std::cout << std::format("speedup: {:.1f}x\n", regex_ns / lexer_ns);
+	return 0;
+}
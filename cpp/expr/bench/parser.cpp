@@ -0,0 +1,77 @@
+// Parse and evaluation time of the precedence-climbing parser against the
+// original recursive evaluator, which rescans the token range at every
+// level, on expressions of 10, 1K and 100K tokens.
+#include "generate.h"
+#include "legacy.h"
+#include "lexer.h"
+#include "parser.h"
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+template <typename Func> static double time_ns(int repeat, Func &&func) {
+	func(); // Warm up caches and grow scratch buffers.
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeat; ++i) {
+		func();
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() /
+		   repeat;
+}
+
+int main() {
+	std::mt19937 rng(42);
+	std::vector<expr::Token> tokens;
+	std::vector<expr::Node> nodes;
+	std::vector<int64_t> values;
+
+	std::cout << std::format("{:>8} {:>14} {:>14} {:>14} {:>10}\n", "tokens",
+							 "legacy (us)", "parse (us)", "parse+eval (us)",
+							 "speedup");
+	for (size_t target : {10, 1000, 100000}) {
+		std::string e = make_expression(rng, target);
+		size_t pos;
+		if (!expr::make_token(e, tokens, pos)) {
+			std::cerr << "failed to tokenize" << std::endl;
+			return 1;
+		}
+
+		int expected = 0;
+		int64_t result = 0;
+		bool legacy_success = true;
+		expected = legacy::eval(tokens, 0, tokens.size() - 1, legacy_success);
+		if (!legacy_success || !expr::parse(tokens, nodes) ||
+			expr::eval(nodes, values, result) != expr::Status::Ok ||
+			result != expected) {
+			std::cerr << "evaluators disagree on a " << tokens.size()
+					  << "-token expression" << std::endl;
+			return 1;
+		}
+
+		int repeat = static_cast<int>(std::max<size_t>(1, 1000000 / target));
+		int legacy_repeat = target > 1000 ? 1 : repeat;
+		int64_t sink = 0;
+		double legacy_ns = time_ns(legacy_repeat, [&]() {
+			bool success = true;
+			sink += legacy::eval(tokens, 0, tokens.size() - 1, success);
+		});
+		double parse_ns = time_ns(repeat, [&]() {
+			sink += expr::parse(tokens, nodes);
+		});
+		double total_ns = time_ns(repeat, [&]() {
+			expr::parse(tokens, nodes);
+			expr::eval(nodes, values, result);
+			sink += result;
+		});
+		std::cout << std::format("{:>8} {:>14.3f} {:>14.3f} {:>14.3f} {:>9.1f}x"
+								 "   (sink {})\n",
+								 tokens.size(), legacy_ns / 1e3,
+								 parse_ns / 1e3, total_ns / 1e3,
+								 legacy_ns / total_ns, sink);
+	}
+	return 0;
+}
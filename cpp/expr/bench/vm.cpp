@@ -0,0 +1,126 @@
+// Evaluations per second of compiled bytecode against lexing and parsing
+// the expression on every evaluation.
+//
+// The bytecode runs on formulas where about half of the literals are
+// variables, bound at run time to the literal they replace, so folding only
+// removes the all-literal parts and both runs still compute the result.
+// Re-parsing evaluates the original all-literal text, which gives the same
+// results.
+#include "bytecode.h"
+#include "generate.h"
+#include "lexer.h"
+#include "parser.h"
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// `e` with each of its one-digit literals replaced, with probability 1/2, by
+// the variable named "v" followed by that digit.
+static std::string with_variables(std::mt19937 &rng, const std::string &e) {
+	std::string s;
+	for (char c : e) {
+		if (expr::is_digit(c) && rng() % 2) {
+			s += 'v';
+		}
+		s += c;
+	}
+	return s;
+}
+
+template <typename Func> static double evals_per_second(int rounds, int count,
+														Func &&func) {
+	func(); // Warm up caches and grow scratch buffers.
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; ++i) {
+		func();
+	}
+	auto end = std::chrono::steady_clock::now();
+	return rounds * count / std::chrono::duration<double>(end - start).count();
+}
+
+int main() {
+	std::mt19937 rng(42);
+	std::vector<expr::Token> tokens;
+	std::vector<expr::Node> nodes;
+	std::vector<int64_t> values;
+
+	std::cout << std::format("{:>8} {:>16} {:>16} {:>16}\n", "tokens",
+							 "parse (M/s)", "bytecode (M/s)", "folded (M/s)");
+	for (size_t target : {10, 100, 1000}) {
+		constexpr int kCount = 1000;
+		std::vector<std::string> formulas;
+		std::vector<expr::Program> programs(kCount), folded(kCount);
+		// Values of the variables of programs[i] and folded[i], in order.
+		std::vector<std::vector<int64_t>> bindings(kCount),
+			folded_bindings(kCount);
+		auto bind = [](const expr::Program &program) {
+			std::vector<int64_t> binding;
+			for (const std::string &name : program.variables) {
+				binding.push_back(name[1] - '0');
+			}
+			return binding;
+		};
+		for (int i = 0; i < kCount; ++i) {
+			formulas.push_back(make_expression(rng, target, 8, true));
+			size_t pos;
+			expr::make_token(formulas[i], tokens, pos);
+			expr::parse(tokens, nodes);
+			int64_t expected;
+			expr::Status status = expr::eval(nodes, values, expected);
+
+			std::string variable_formula = with_variables(rng, formulas[i]);
+			expr::make_token(variable_formula, tokens, pos);
+			expr::parse(tokens, nodes);
+			expr::compile(nodes, programs[i], false);
+			expr::compile(nodes, folded[i]);
+			bindings[i] = bind(programs[i]);
+			folded_bindings[i] = bind(folded[i]);
+
+			int64_t result, folded_result;
+			if (status != expr::Status::Ok ||
+				expr::run(programs[i], bindings[i], values, result) !=
+					expr::Status::Ok ||
+				expr::run(folded[i], folded_bindings[i], values,
+						  folded_result) != expr::Status::Ok ||
+				result != expected || folded_result != expected) {
+				std::cerr << "bytecode disagrees on: " << formulas[i]
+						  << std::endl;
+				return 1;
+			}
+		}
+
+		int rounds = static_cast<int>(10000 / target);
+		long sink = 0;
+		double parse = evals_per_second(rounds, kCount, [&]() {
+			for (const auto &formula : formulas) {
+				size_t pos;
+				int64_t result;
+				expr::make_token(formula, tokens, pos);
+				expr::parse(tokens, nodes);
+				expr::eval(nodes, values, result);
+				sink += result;
+			}
+		});
+		double bytecode = evals_per_second(rounds, kCount, [&]() {
+			for (int i = 0; i < kCount; ++i) {
+				int64_t result;
+				expr::run(programs[i], bindings[i], values, result);
+				sink += result;
+			}
+		});
+		double fold = evals_per_second(rounds, kCount, [&]() {
+			for (int i = 0; i < kCount; ++i) {
+				int64_t result;
+				expr::run(folded[i], folded_bindings[i], values, result);
+				sink += result;
+			}
+		});
+		std::cout << std::format("{:>8} {:>16.3f} {:>16.3f} {:>16.3f}"
+								 "   (sink {})\n",
+								 target, parse / 1e6, bytecode / 1e6,
+								 fold / 1e6, sink);
+	}
+	return 0;
+}
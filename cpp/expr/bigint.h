@@ -0,0 +1,273 @@
+#pragma once
+
+// Arbitrary-precision fallback for expressions whose 64-bit evaluation
+// reported Status::Overflow. It is only ever engaged then, so it favours
+// simplicity over speed.
+
+#include "bytecode.h"
+#include "expr.h"
+#include <algorithm>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace expr {
+
+class BigInt {
+  public:
+	BigInt() = default;
+	BigInt(int64_t value) : negative(value < 0) {
+		// Negate as unsigned so that the smallest value does not overflow.
+		uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(value)
+									  : static_cast<uint64_t>(value);
+		while (magnitude) {
+			limbs.push_back(static_cast<uint32_t>(magnitude));
+			magnitude >>= 32;
+		}
+	}
+
+	// Value of the digits of a literal, as split by `literal_digits`.
+	static BigInt Parse(std::string_view digits, int base) {
+		BigInt result;
+		for (char c : digits) {
+			result = result * BigInt(base) + BigInt(digit_value(c));
+		}
+		return result;
+	}
+
+	bool IsZero() const { return limbs.empty(); }
+
+	friend bool operator==(const BigInt &, const BigInt &) = default;
+
+	friend BigInt operator-(BigInt x) {
+		x.negative = !x.negative && !x.IsZero();
+		return x;
+	}
+
+	friend BigInt operator+(const BigInt &x, const BigInt &y) {
+		if (x.negative == y.negative) {
+			return BigInt(x.negative, Add(x.limbs, y.limbs));
+		}
+		// Subtract the smaller magnitude from the larger one, whose sign
+		// the result takes.
+		if (Compare(x.limbs, y.limbs) >= 0) {
+			return BigInt(x.negative, Sub(x.limbs, y.limbs));
+		}
+		return BigInt(y.negative, Sub(y.limbs, x.limbs));
+	}
+
+	friend BigInt operator-(const BigInt &x, const BigInt &y) {
+		return x + -y;
+	}
+
+	friend BigInt operator*(const BigInt &x, const BigInt &y) {
+		return BigInt(x.negative != y.negative, Mul(x.limbs, y.limbs));
+	}
+
+	// Quotient truncated toward zero, as for built-in integers. `y` must not
+	// be zero.
+	friend BigInt operator/(const BigInt &x, const BigInt &y) {
+		return BigInt(x.negative != y.negative, Div(x.limbs, y.limbs));
+	}
+
+	std::string ToString() const {
+		if (IsZero()) {
+			return "0";
+		}
+		// Peel off nine decimal digits at a time.
+		std::string digits;
+		std::vector<uint32_t> rest = limbs;
+		while (!rest.empty()) {
+			uint32_t chunk = DivSmall(rest, 1000000000);
+			for (int i = 0; i < 9 && (chunk || !rest.empty()); ++i) {
+				digits += static_cast<char>('0' + chunk % 10);
+				chunk /= 10;
+			}
+		}
+		if (negative) {
+			digits += '-';
+		}
+		std::reverse(digits.begin(), digits.end());
+		return digits;
+	}
+
+  private:
+	// Magnitude, least significant limb first, without leading zero limbs.
+	using Limbs = std::vector<uint32_t>;
+
+	BigInt(bool negative, Limbs limbs) : limbs(std::move(limbs)) {
+		Trim(this->limbs);
+		this->negative = negative && !this->limbs.empty();
+	}
+
+	static void Trim(Limbs &x) {
+		while (!x.empty() && x.back() == 0) {
+			x.pop_back();
+		}
+	}
+
+	static int Compare(const Limbs &x, const Limbs &y) {
+		if (x.size() != y.size()) {
+			return x.size() < y.size() ? -1 : 1;
+		}
+		for (size_t i = x.size(); i-- > 0;) {
+			if (x[i] != y[i]) {
+				return x[i] < y[i] ? -1 : 1;
+			}
+		}
+		return 0;
+	}
+
+	static Limbs Add(const Limbs &x, const Limbs &y) {
+		Limbs sum(std::max(x.size(), y.size()) + 1);
+		uint64_t carry = 0;
+		for (size_t i = 0; i + 1 < sum.size(); ++i) {
+			carry += uint64_t(i < x.size() ? x[i] : 0) + (i < y.size() ? y[i] : 0);
+			sum[i] = static_cast<uint32_t>(carry);
+			carry >>= 32;
+		}
+		sum.back() = static_cast<uint32_t>(carry);
+		return sum;
+	}
+
+	// x - y for x >= y.
+	static Limbs Sub(const Limbs &x, const Limbs &y) {
+		Limbs difference(x.size());
+		int64_t borrow = 0;
+		for (size_t i = 0; i < x.size(); ++i) {
+			int64_t d = int64_t(x[i]) - (i < y.size() ? y[i] : 0) - borrow;
+			borrow = d < 0;
+			difference[i] = static_cast<uint32_t>(d + (borrow << 32));
+		}
+		return difference;
+	}
+
+	static Limbs Mul(const Limbs &x, const Limbs &y) {
+		Limbs product(x.size() + y.size());
+		for (size_t i = 0; i < x.size(); ++i) {
+			uint64_t carry = 0;
+			for (size_t j = 0; j < y.size(); ++j) {
+				carry += uint64_t(x[i]) * y[j] + product[i + j];
+				product[i + j] = static_cast<uint32_t>(carry);
+				carry >>= 32;
+			}
+			product[i + y.size()] = static_cast<uint32_t>(carry);
+		}
+		return product;
+	}
+
+	// Divide `x` by `y` in place, returning the remainder.
+	static uint32_t DivSmall(Limbs &x, uint32_t y) {
+		uint64_t remainder = 0;
+		for (size_t i = x.size(); i-- > 0;) {
+			remainder = remainder << 32 | x[i];
+			x[i] = static_cast<uint32_t>(remainder / y);
+			remainder %= y;
+		}
+		Trim(x);
+		return static_cast<uint32_t>(remainder);
+	}
+
+	// Binary long division, one bit of the quotient at a time.
+	static Limbs Div(const Limbs &x, const Limbs &y) {
+		if (y.size() == 1) {
+			Limbs quotient = x;
+			DivSmall(quotient, y[0]);
+			return quotient;
+		}
+		Limbs quotient(x.size()), remainder;
+		for (size_t bit = x.size() * 32; bit-- > 0;) {
+			// remainder = remainder * 2 + next bit of x.
+			uint32_t carry = x[bit / 32] >> (bit % 32) & 1;
+			for (uint32_t &limb : remainder) {
+				uint32_t top = limb >> 31;
+				limb = limb << 1 | carry;
+				carry = top;
+			}
+			if (carry) {
+				remainder.push_back(carry);
+			}
+			if (Compare(remainder, y) >= 0) {
+				remainder = Sub(remainder, y);
+				Trim(remainder);
+				quotient[bit / 32] |= uint32_t(1) << (bit % 32);
+			}
+		}
+		return quotient;
+	}
+
+	bool negative = false;
+	Limbs limbs;
+};
+
+// Evaluate a tree built by `parse` like `eval`, but on arbitrary-precision
+// integers, reading literals too large for 64 bits in full. Fails on
+// division by zero and on variables.
+inline Status eval_big(std::span<const Node> nodes, BigInt &result) {
+	if (nodes.empty()) {
+		return Status::Failed;
+	}
+	std::vector<BigInt> values(nodes.size());
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const Node &node = nodes[i];
+		BigInt &value = values[i];
+		// Every operand is used by a single node, so it can be moved from.
+		BigInt lhs = node.lhs >= 0 ? std::move(values[node.lhs]) : BigInt();
+		BigInt rhs = node.rhs >= 0 ? std::move(values[node.rhs]) : BigInt();
+		switch (node.type) {
+		case TK_DEC:
+			value = BigInt(node.value);
+			break;
+		case TK_BIG: {
+			int base;
+			std::string_view digits =
+				literal_digits(static_cast<int>(node.value), node.str, base);
+			value = BigInt::Parse(digits, base);
+			break;
+		}
+		case TK_VAR:
+			return Status::Failed;
+		case TK_NEG:
+			value = -std::move(lhs);
+			break;
+		case TK_EQ:
+			value = BigInt(lhs == rhs);
+			break;
+		case '+':
+			value = lhs + rhs;
+			break;
+		case '-':
+			value = lhs - rhs;
+			break;
+		case '*':
+			value = lhs * rhs;
+			break;
+		case '/':
+			if (rhs.IsZero()) {
+				return Status::Failed;
+			}
+			value = lhs / rhs;
+			break;
+		}
+	}
+	result = std::move(values.back());
+	return Status::Ok;
+}
+
+// Evaluate `e` on arbitrary-precision integers, for when `evaluate` returned
+// Status::Overflow.
+inline Status evaluate_big(std::string_view e, Context &ctx, BigInt &result) {
+	if (Status status = tokenize(e, ctx); status != Status::Ok) {
+		return status;
+	}
+	if (!parse(ctx)) {
+		return Status::Failed;
+	}
+	return eval_big(ctx.nodes, result);
+}
+
+} // namespace expr
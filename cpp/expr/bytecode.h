@@ -0,0 +1,204 @@
+#pragma once
+
+#include "parser.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace expr {
+
+enum class Op : uint8_t {
+	Push, // Push `operand`.
+	Load, // Push variable number `operand`.
+	Neg,
+	Add,
+	Sub,
+	Mul,
+	Div,
+	Eq,
+};
+
+struct Instr {
+	Op op;
+	int64_t operand;
+};
+
+// Postfix code of a compiled expression, run on a stack of `max_stack`
+// values. `variables` names the variables `Load` refers to, in order of first
+// appearance.
+struct Program {
+	std::vector<Instr> code;
+	size_t max_stack = 0;
+	std::vector<std::string> variables;
+};
+
+constexpr Op binary_op(int type) {
+	switch (type) {
+	case '+':
+		return Op::Add;
+	case '-':
+		return Op::Sub;
+	case '*':
+		return Op::Mul;
+	case '/':
+		return Op::Div;
+	default:
+		return Op::Eq;
+	}
+}
+
+// Apply a binary operator. Fails on division by zero and on overflow.
+constexpr bool apply(Op op, int64_t lhs, int64_t rhs, int64_t &result) {
+	switch (op) {
+	case Op::Add:
+		return !__builtin_add_overflow(lhs, rhs, &result);
+	case Op::Sub:
+		return !__builtin_sub_overflow(lhs, rhs, &result);
+	case Op::Mul:
+		return !__builtin_mul_overflow(lhs, rhs, &result);
+	case Op::Div:
+		return rhs != 0 && !div_overflow(lhs, rhs, result);
+	case Op::Eq:
+		result = lhs == rhs;
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Compile a tree built by `parse` into `program`. With `fold`, operators
+// whose operands are all literals are evaluated here and replaced by a
+// single push, except for divisions by zero and overflows, which are left
+// to be reported at run time. The tree must be free of TK_BIG literals,
+// which a program cannot hold; they overflow whatever the rest is.
+constexpr void compile(std::span<const Node> nodes, Program &program,
+					   bool fold = true) {
+	// Operand of the code emitted so far: where its code starts and, if it
+	// is a constant, its value.
+	struct Operand {
+		size_t begin;
+		bool constant;
+		int64_t value;
+	};
+	std::vector<Operand> operands;
+	program.code.clear();
+	program.max_stack = 0;
+	program.variables.clear();
+
+	// Nodes are in post-order, which is the order postfix code needs.
+	for (const Node &node : nodes) {
+		if (node.type == TK_DEC) {
+			operands.push_back(Operand{program.code.size(), true, node.value});
+			program.code.push_back(Instr{Op::Push, node.value});
+		} else if (node.type == TK_VAR) {
+			auto &variables = program.variables;
+			auto it = std::find(variables.begin(), variables.end(), node.str);
+			if (it == variables.end()) {
+				it = variables.emplace(it, node.str);
+			}
+			operands.push_back(Operand{program.code.size(), false, 0});
+			program.code.push_back(
+				Instr{Op::Load, it - variables.begin()});
+		} else if (node.type == TK_NEG) {
+			Operand &operand = operands.back();
+			int64_t value;
+			if (fold && operand.constant &&
+				!neg_overflow(operand.value, value)) {
+				operand.value = value;
+				program.code.resize(operand.begin);
+				program.code.push_back(Instr{Op::Push, value});
+			} else {
+				operand.constant = false;
+				program.code.push_back(Instr{Op::Neg, 0});
+			}
+		} else {
+			Operand rhs = operands.back();
+			operands.pop_back();
+			Operand &lhs = operands.back();
+			Op op = binary_op(node.type);
+			int64_t value;
+			if (fold && lhs.constant && rhs.constant &&
+				apply(op, lhs.value, rhs.value, value)) {
+				lhs.value = value;
+				program.code.resize(lhs.begin);
+				program.code.push_back(Instr{Op::Push, value});
+			} else {
+				lhs.constant = false;
+				program.code.push_back(Instr{op, 0});
+			}
+		}
+		program.max_stack = std::max(program.max_stack, operands.size());
+	}
+}
+
+// Run `code` on `stack`, which must have room for as many values as the
+// code pushes at once. Overflows are checked as in `eval`.
+constexpr Status run(std::span<const Instr> code,
+					 std::span<const int64_t> variables, int64_t *stack,
+					 int64_t &result) {
+	int64_t *sp = stack; // Next free slot.
+	bool overflow = false;
+	for (const Instr &instr : code) {
+		switch (instr.op) {
+		case Op::Push:
+			*sp++ = instr.operand;
+			break;
+		case Op::Load:
+			*sp++ = variables[instr.operand];
+			break;
+		case Op::Neg:
+			overflow |= neg_overflow(sp[-1], sp[-1]);
+			break;
+		case Op::Add:
+			overflow |= __builtin_add_overflow(sp[-2], sp[-1], &sp[-2]);
+			--sp;
+			break;
+		case Op::Sub:
+			overflow |= __builtin_sub_overflow(sp[-2], sp[-1], &sp[-2]);
+			--sp;
+			break;
+		case Op::Mul:
+			overflow |= __builtin_mul_overflow(sp[-2], sp[-1], &sp[-2]);
+			--sp;
+			break;
+		case Op::Div:
+			if (sp[-1] == 0) {
+				return overflow ? Status::Overflow : Status::Failed;
+			}
+			overflow |= div_overflow(sp[-2], sp[-1], sp[-2]);
+			--sp;
+			break;
+		case Op::Eq:
+			sp[-2] = sp[-2] == sp[-1];
+			--sp;
+			break;
+		}
+	}
+	result = sp[-1];
+	return overflow ? Status::Overflow : Status::Ok;
+}
+
+// Run `program` with `variables[i]` bound to `program.variables[i]`.
+// `stack` is scratch space with room for `program.max_stack` values, reused
+// across calls to avoid allocating. Fails on division by zero and if a
+// variable is left unbound.
+template <typename Stack>
+Status run(const Program &program, std::span<const int64_t> variables,
+		   Stack &stack, int64_t &result) {
+	if (program.code.empty() || variables.size() < program.variables.size()) {
+		return Status::Failed;
+	}
+	stack.resize(program.max_stack);
+	return run(program.code, variables, stack.data(), result);
+}
+
+// Run a `program` without variables.
+template <typename Stack>
+Status run(const Program &program, Stack &stack, int64_t &result) {
+	return run(program, {}, stack, result);
+}
+
+} // namespace expr
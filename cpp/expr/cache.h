@@ -0,0 +1,110 @@
+#pragma once
+
+#include "bytecode.h"
+#include "expr.h"
+#include "lrucache.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace expr {
+
+// Bounded cache from expression text to its compiled program, so that
+// evaluating a repeated expression skips lexing and parsing. Entries are
+// keyed by the hash of the text, which is kept alongside the program to
+// tell collisions apart. Not thread-safe; give each thread its own.
+class ProgramCache {
+  public:
+	explicit ProgramCache(size_t capacity) : capacity(capacity) {
+		lru.onRemoval = [this](std::pair<size_t, Entry> &&evicted,
+							   RemovalCause) {
+			spare = std::move(evicted.second);
+		};
+	}
+	// The removal listener refers to `this`.
+	ProgramCache(const ProgramCache &) = delete;
+	ProgramCache &operator=(const ProgramCache &) = delete;
+
+	size_t Capacity() const { return capacity; }
+	size_t Size() const { return lru.Size(); }
+	size_t Hits() const { return hits; }
+	size_t Misses() const { return misses; }
+
+	// Compiled program of `e`, lexing, parsing and compiling it with `ctx` on
+	// a miss. Expressions failing to parse, or holding a literal too large
+	// for 64 bits, are not cached; `status` tells why and nullptr is
+	// returned. The program stays valid until the next call.
+	const Program *Lookup(std::string_view e, Context &ctx, Status &status) {
+		size_t key = std::hash<std::string_view>{}(e);
+		Entry *entry = capacity > 0 ? lru.Get(key) : nullptr;
+		if (entry && entry->text == e) {
+			++hits;
+			status = Status::Ok;
+			return &entry->program;
+		}
+		++misses;
+
+		status = tokenize(e, ctx);
+		if (status != Status::Ok) {
+			return nullptr;
+		}
+		if (!parse(ctx)) {
+			status = Status::Failed;
+			return nullptr;
+		}
+		if (std::any_of(ctx.nodes.begin(), ctx.nodes.end(),
+						[](const Node &node) { return node.type == TK_BIG; })) {
+			status = Status::Overflow;
+			return nullptr;
+		}
+		if (entry) {
+			// Hash collision: replace the other expression.
+			entry->text = e;
+			compile(ctx.nodes, entry->program);
+			return &entry->program;
+		}
+		// Make room first: the evicted entry lands in `spare`, whose buffers
+		// are then reused for the new one.
+		if (capacity > 0 && lru.Size() == capacity) {
+			lru.Evict();
+		}
+		spare.text = e;
+		compile(ctx.nodes, spare.program);
+		if (capacity == 0) {
+			return &spare.program;
+		}
+		return &lru.Put(key, std::move(spare)).program;
+	}
+
+  private:
+	struct Entry {
+		std::string text;
+		Program program;
+	};
+
+	LRUCache<size_t, Entry> lru;
+	size_t capacity;
+	// Entry last evicted, or the only one when `capacity` is 0.
+	Entry spare;
+	size_t hits = 0;
+	size_t misses = 0;
+};
+
+// Evaluate `e`, reusing its compiled program from `cache` if there.
+inline Status evaluate(std::string_view e, Context &ctx, ProgramCache &cache,
+					   int64_t &result) {
+	// Lexing on a miss resets the arena too, but a hit does not.
+	ctx.arena.Reset();
+	Status status;
+	const Program *program = cache.Lookup(e, ctx, status);
+	if (!program) {
+		return status;
+	}
+	ctx.values = FixedVector<int64_t>(ctx.arena, program->max_stack);
+	return run(*program, ctx.values, result);
+}
+
+} // namespace expr
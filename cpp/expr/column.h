@@ -0,0 +1,448 @@
+#pragma once
+
+// Columnar evaluation: a compiled `Program` runs over whole columns of
+// `int64_t` or `double` values bound to its variables, one operator at a
+// time, instead of one row at a time.
+//
+// Rows are processed in blocks of `kBlockRows` so intermediate results stay
+// in cache. Within a block every operator is a single loop over contiguous
+// values, using AVX2 when the CPU has it and a scalar loop otherwise.
+
+#include "bytecode.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace expr {
+
+enum class ColumnType : uint8_t {
+	Int,   // int64_t, wrapping on overflow.
+	Float, // double.
+};
+
+// Values of a variable, one per row. `data` points to `int64_t` or `double`
+// values as given by `type` and must outlive the evaluation.
+struct Column {
+	ColumnType type;
+	const void *data;
+};
+
+struct ColumnResult {
+	ColumnType type = ColumnType::Int;
+	std::vector<int64_t> ints;	 // Set if `type` is Int.
+	std::vector<double> floats; // Set if `type` is Float.
+};
+
+constexpr size_t kBlockRows = 2048;
+
+// Loop over `n` values of an operator. For a unary operator `b` is unused.
+// Operands marked scalar point to a single value applied to every row.
+// Returns false on integer division by zero.
+using Kernel = bool (*)(const void *a, const void *b, void *out, size_t n);
+
+namespace column_detail {
+
+// Integer ops go through uint64_t, which wraps instead of overflowing.
+inline int64_t wrap_add(int64_t x, int64_t y) {
+	return static_cast<int64_t>(static_cast<uint64_t>(x) +
+								static_cast<uint64_t>(y));
+}
+
+inline int64_t wrap_sub(int64_t x, int64_t y) {
+	return static_cast<int64_t>(static_cast<uint64_t>(x) -
+								static_cast<uint64_t>(y));
+}
+
+inline int64_t wrap_mul(int64_t x, int64_t y) {
+	return static_cast<int64_t>(static_cast<uint64_t>(x) *
+								static_cast<uint64_t>(y));
+}
+
+template <Op op, typename T>
+using Out = std::conditional_t<op == Op::Eq, int64_t, T>;
+
+template <Op op, typename T, bool AScalar, bool BScalar>
+bool scalar_kernel(const void *va, const void *vb, void *vout, size_t n) {
+	auto a = static_cast<const T *>(va);
+	auto b = static_cast<const T *>(vb);
+	auto out = static_cast<Out<op, T> *>(vout);
+	bool ok = true;
+	for (size_t i = 0; i < n; ++i) {
+		T x = a[AScalar ? 0 : i];
+		T y = op == Op::Neg ? T() : b[BScalar ? 0 : i];
+		if constexpr (op == Op::Eq) {
+			out[i] = x == y;
+		} else if constexpr (std::is_floating_point_v<T>) {
+			switch (op) {
+			case Op::Neg:
+				out[i] = -x;
+				break;
+			case Op::Add:
+				out[i] = x + y;
+				break;
+			case Op::Sub:
+				out[i] = x - y;
+				break;
+			case Op::Mul:
+				out[i] = x * y;
+				break;
+			default:
+				out[i] = x / y;
+				break;
+			}
+		} else {
+			switch (op) {
+			case Op::Neg:
+				out[i] = wrap_sub(0, x);
+				break;
+			case Op::Add:
+				out[i] = wrap_add(x, y);
+				break;
+			case Op::Sub:
+				out[i] = wrap_sub(x, y);
+				break;
+			case Op::Mul:
+				out[i] = wrap_mul(x, y);
+				break;
+			default:
+				// x / -1 traps for the smallest int64_t, so negate instead.
+				ok &= y != 0;
+				out[i] = y == -1 ? wrap_sub(0, x) : y == 0 ? 0 : x / y;
+				break;
+			}
+		}
+	}
+	return ok;
+}
+
+inline bool int_to_float(const void *va, const void *, void *vout, size_t n) {
+	auto a = static_cast<const int64_t *>(va);
+	auto out = static_cast<double *>(vout);
+	for (size_t i = 0; i < n; ++i) {
+		out[i] = static_cast<double>(a[i]);
+	}
+	return true;
+}
+
+#if defined(__x86_64__)
+
+inline bool has_avx2() {
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	return avx2;
+}
+
+// AVX2 has no 64-bit integer multiply or any division, so only these ops
+// get a vector kernel for `int64_t`.
+template <Op op, typename T> constexpr bool has_avx2_kernel() {
+	return std::is_floating_point_v<T> || op == Op::Add || op == Op::Sub ||
+		   op == Op::Neg || op == Op::Eq;
+}
+
+template <Op op, bool AScalar, bool BScalar>
+__attribute__((target("avx2"))) bool
+avx2_float_kernel(const void *va, const void *vb, void *vout, size_t n) {
+	auto a = static_cast<const double *>(va);
+	auto b = static_cast<const double *>(vb);
+	__m256d x = _mm256_set1_pd(a[0]);
+	__m256d y = op == Op::Neg ? _mm256_setzero_pd() : _mm256_set1_pd(b[0]);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		if constexpr (!AScalar) {
+			x = _mm256_loadu_pd(a + i);
+		}
+		if constexpr (!BScalar && op != Op::Neg) {
+			y = _mm256_loadu_pd(b + i);
+		}
+		if constexpr (op == Op::Eq) {
+			__m256i mask = _mm256_castpd_si256(_mm256_cmp_pd(x, y, _CMP_EQ_OQ));
+			_mm256_storeu_si256(
+				reinterpret_cast<__m256i *>(static_cast<int64_t *>(vout) + i),
+				_mm256_and_si256(mask, _mm256_set1_epi64x(1)));
+		} else {
+			__m256d r;
+			if constexpr (op == Op::Neg) {
+				r = _mm256_xor_pd(x, _mm256_set1_pd(-0.0));
+			} else if constexpr (op == Op::Add) {
+				r = _mm256_add_pd(x, y);
+			} else if constexpr (op == Op::Sub) {
+				r = _mm256_sub_pd(x, y);
+			} else if constexpr (op == Op::Mul) {
+				r = _mm256_mul_pd(x, y);
+			} else {
+				r = _mm256_div_pd(x, y);
+			}
+			_mm256_storeu_pd(static_cast<double *>(vout) + i, r);
+		}
+	}
+	return scalar_kernel<op, double, AScalar, BScalar>(
+		AScalar ? a : a + i, BScalar ? b : b + i,
+		static_cast<Out<op, double> *>(vout) + i, n - i);
+}
+
+template <Op op, bool AScalar, bool BScalar>
+__attribute__((target("avx2"))) bool
+avx2_int_kernel(const void *va, const void *vb, void *vout, size_t n) {
+	auto a = static_cast<const int64_t *>(va);
+	auto b = static_cast<const int64_t *>(vb);
+	auto out = static_cast<int64_t *>(vout);
+	__m256i x = _mm256_set1_epi64x(a[0]);
+	__m256i y =
+		op == Op::Neg ? _mm256_setzero_si256() : _mm256_set1_epi64x(b[0]);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		if constexpr (!AScalar) {
+			x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		}
+		if constexpr (!BScalar && op != Op::Neg) {
+			y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		}
+		__m256i r;
+		if constexpr (op == Op::Neg) {
+			r = _mm256_sub_epi64(_mm256_setzero_si256(), x);
+		} else if constexpr (op == Op::Add) {
+			r = _mm256_add_epi64(x, y);
+		} else if constexpr (op == Op::Sub) {
+			r = _mm256_sub_epi64(x, y);
+		} else {
+			r = _mm256_and_si256(_mm256_cmpeq_epi64(x, y),
+								 _mm256_set1_epi64x(1));
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), r);
+	}
+	return scalar_kernel<op, int64_t, AScalar, BScalar>(
+		AScalar ? a : a + i, BScalar ? b : b + i, out + i, n - i);
+}
+
+#endif
+
+template <Op op, typename T, bool AScalar, bool BScalar>
+Kernel pick_kernel(bool simd) {
+#if defined(__x86_64__)
+	if constexpr (has_avx2_kernel<op, T>()) {
+		if (simd && has_avx2()) {
+			if constexpr (std::is_floating_point_v<T>) {
+				return avx2_float_kernel<op, AScalar, BScalar>;
+			} else {
+				return avx2_int_kernel<op, AScalar, BScalar>;
+			}
+		}
+	}
+#endif
+	(void)simd;
+	return scalar_kernel<op, T, AScalar, BScalar>;
+}
+
+template <Op op, typename T>
+Kernel pick_kernel(bool a_scalar, bool b_scalar, bool simd) {
+	if (a_scalar && b_scalar) {
+		// Only ever run on a single row.
+		return scalar_kernel<op, T, true, true>;
+	} else if (a_scalar) {
+		return pick_kernel<op, T, true, false>(simd);
+	} else if (b_scalar) {
+		return pick_kernel<op, T, false, true>(simd);
+	}
+	return pick_kernel<op, T, false, false>(simd);
+}
+
+template <typename T>
+Kernel pick_kernel(Op op, bool a_scalar, bool b_scalar, bool simd) {
+	switch (op) {
+	case Op::Neg:
+		return pick_kernel<Op::Neg, T>(a_scalar, a_scalar, simd);
+	case Op::Add:
+		return pick_kernel<Op::Add, T>(a_scalar, b_scalar, simd);
+	case Op::Sub:
+		return pick_kernel<Op::Sub, T>(a_scalar, b_scalar, simd);
+	case Op::Mul:
+		return pick_kernel<Op::Mul, T>(a_scalar, b_scalar, simd);
+	case Op::Div:
+		return pick_kernel<Op::Div, T>(a_scalar, b_scalar, simd);
+	default:
+		return pick_kernel<Op::Eq, T>(a_scalar, b_scalar, simd);
+	}
+}
+
+// Where an operand lives: an input column, a constant, a scratch block (one
+// per stack slot), or the result column.
+struct Ref {
+	enum Kind : uint8_t { Input, Constant, Scratch, Output } kind;
+	uint32_t index;
+};
+
+// An operand on the stack while planning.
+struct Slot {
+	ColumnType type;
+	bool scalar;
+	Ref ref;
+};
+
+// One loop over a block: `kernel(a, b, out, rows)`.
+struct Step {
+	Kernel kernel;
+	Ref a, b, out;
+};
+
+union Scalar {
+	int64_t i;
+	double f;
+};
+
+} // namespace column_detail
+
+// Evaluate `program` over `rows` rows, binding each of its variables to the
+// column of the same name in `columns`. Operators on two Int operands give
+// Int, as does `==`; anything else involving a Float operand gives Float.
+// Fails if a variable is unbound or on integer division by zero. `simd`
+// false forces the scalar kernels.
+inline bool eval_columns(const Program &program,
+						 const std::map<std::string, Column, std::less<>> &columns,
+						 size_t rows, ColumnResult &result, bool simd = true) {
+	using namespace column_detail;
+	if (program.code.empty()) {
+		return false;
+	}
+	std::vector<Column> inputs;
+	for (const auto &name : program.variables) {
+		auto it = columns.find(name);
+		if (it == columns.end()) {
+			return false;
+		}
+		inputs.push_back(it->second);
+	}
+
+	// Plan the loops for one block by running the program on operand types.
+	std::vector<Scalar> constants;
+	std::vector<Step> steps;
+	std::vector<Slot> stack;
+	auto constant_ptr = [&](Ref ref) -> void * {
+		return &constants[ref.index];
+	};
+	// Ints meeting a Float are converted first.
+	auto to_float = [&](Slot &slot) {
+		if (slot.type == ColumnType::Float) {
+			return;
+		}
+		slot.type = ColumnType::Float;
+		if (slot.scalar) {
+			auto &c = constants[slot.ref.index];
+			c.f = static_cast<double>(c.i);
+			return;
+		}
+		Ref out = Ref{Ref::Scratch, static_cast<uint32_t>(&slot - &stack[0])};
+		steps.push_back(Step{int_to_float, slot.ref, slot.ref, out});
+		slot.ref = out;
+	};
+	for (const Instr &instr : program.code) {
+		if (instr.op == Op::Push) {
+			constants.push_back(Scalar{.i = instr.operand});
+			stack.push_back(Slot{ColumnType::Int, true,
+								 Ref{Ref::Constant,
+									 static_cast<uint32_t>(constants.size() -
+														   1)}});
+			continue;
+		}
+		if (instr.op == Op::Load) {
+			stack.push_back(
+				Slot{inputs[instr.operand].type, false,
+					 Ref{Ref::Input, static_cast<uint32_t>(instr.operand)}});
+			continue;
+		}
+		Slot *a = &stack[stack.size() - (instr.op == Op::Neg ? 1 : 2)];
+		Slot *b = &stack.back();
+		if (a->type != b->type) {
+			to_float(*a);
+			to_float(*b);
+		}
+		ColumnType type = a->type;
+		Kernel kernel =
+			type == ColumnType::Float
+				? pick_kernel<double>(instr.op, a->scalar, b->scalar, simd)
+				: pick_kernel<int64_t>(instr.op, a->scalar, b->scalar, simd);
+		Slot out{instr.op == Op::Eq ? ColumnType::Int : type,
+				 a->scalar && b->scalar, {}};
+		if (out.scalar) {
+			// Left unfolded by the compiler; fold it here.
+			constants.push_back(Scalar{});
+			out.ref = Ref{Ref::Constant,
+						  static_cast<uint32_t>(constants.size() - 1)};
+			if (!kernel(constant_ptr(a->ref), constant_ptr(b->ref),
+						constant_ptr(out.ref), 1)) {
+				return false;
+			}
+		}
+		if (!out.scalar) {
+			// The result replaces the first operand on the stack.
+			out.ref = Ref{Ref::Scratch, static_cast<uint32_t>(a - &stack[0])};
+			steps.push_back(Step{kernel, a->ref, b->ref, out.ref});
+		}
+		if (instr.op != Op::Neg) {
+			stack.pop_back();
+		}
+		stack.back() = out;
+	}
+
+	// The last loop writes straight into the result.
+	Slot final = stack.back();
+	result.type = final.type;
+	result.ints.clear();
+	result.floats.clear();
+	void *output;
+	if (final.type == ColumnType::Int) {
+		result.ints.resize(rows);
+		output = result.ints.data();
+	} else {
+		result.floats.resize(rows);
+		output = result.floats.data();
+	}
+	if (!steps.empty() && final.ref.kind == Ref::Scratch) {
+		steps.back().out = Ref{Ref::Output, 0};
+	}
+
+	// Both column types have 8-byte values.
+	std::vector<std::vector<int64_t>> blocks(program.max_stack,
+											 std::vector<int64_t>(kBlockRows));
+	for (size_t row = 0; row < rows; row += kBlockRows) {
+		size_t n = std::min(kBlockRows, rows - row);
+		auto resolve = [&](Ref ref) -> void * {
+			switch (ref.kind) {
+			case Ref::Input:
+				return const_cast<int64_t *>(
+						   static_cast<const int64_t *>(inputs[ref.index].data)) +
+					   row;
+			case Ref::Constant:
+				return &constants[ref.index];
+			case Ref::Scratch:
+				return blocks[ref.index].data();
+			default:
+				return static_cast<int64_t *>(output) + row;
+			}
+		};
+		for (const Step &step : steps) {
+			if (!step.kernel(resolve(step.a), resolve(step.b), resolve(step.out),
+							 n)) {
+				return false;
+			}
+		}
+		if (final.ref.kind != Ref::Scratch) {
+			// The result is a constant or an input column.
+			int64_t *dest = static_cast<int64_t *>(output) + row;
+			const int64_t *src = static_cast<int64_t *>(resolve(final.ref));
+			for (size_t i = 0; i < n; ++i) {
+				dest[i] = src[final.scalar ? 0 : i];
+			}
+		}
+	}
+	return true;
+}
+
+} // namespace expr
@@ -1,225 +1,276 @@
+#include "bigint.h"
+#include "cache.h"
+#include "expr.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
 #include <format>
 #include <iostream>
-#include <regex>
+#include <iterator>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
-template <typename T1, typename T2> inline bool notin(T1 first, T2 second) {
-	return first != second;
-}
-
-template <typename T1, typename T2, typename... Args>
-inline bool notin(T1 first, T2 second, Args... others) {
-	return first != second && notin(first, others...);
-}
+// Bytes of input handed to a worker at a time, rounded up to a full line.
+constexpr size_t kChunkBytes = 1 << 20;
+// Default number of compiled expressions cached per thread.
+constexpr size_t kCacheEntries = 1024;
+// Chunks evaluated ahead of the writer. Bounds memory to this many output
+// buffers, which are reused round-robin.
+constexpr size_t kWindow = 64;
 
-enum {
-	TK_NOTYPE = 256,
-	TK_EQ,
-	TK_DEC,
-	TK_OCT,
-	TK_HEX,
-	TK_NEG,
+struct Options {
+	std::string input;	// Batch input, empty for the REPL.
+	std::string output; // Batch output, empty for stdout.
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t cache_entries = kCacheEntries;
+	// Evaluate on arbitrary-precision integers when 64 bits overflow,
+	// instead of failing.
+	bool bigint = true;
 };
 
-static struct rule {
-	std::regex regex;
-	int token_type;
-} rules[] = {
-	{std::regex(" +"), TK_NOTYPE},			   // spaces
-	{std::regex("\\+"), '+'},				   // plus
-	{std::regex("-"), '-'},					   // minus
-	{std::regex("\\*"), '*'},				   // multiply
-	{std::regex("\\/"), '/'},				   // divide
-	{std::regex("\\("), '('},				   // left bracket
-	{std::regex("\\)"), ')'},				   // right bracket
-	{std::regex("=="), TK_EQ},				   // equal
-	{std::regex("0[0-7]+"), TK_OCT},		   // octal
-	{std::regex("0[xX][0-9a-fA-F]+"), TK_HEX}, // hex
-	{std::regex("0|^[1-9][0-9]*"), TK_DEC},	   // decimal
+struct Chunk {
+	std::string output;
+	std::atomic<bool> ready{false};
 };
 
-static size_t NR_REGEX = sizeof(rules) / sizeof(rules[0]);
-
-typedef struct token {
-	int type;
-	std::string str;
-} Token;
-
-static std::vector<Token> tokens;
-
-static bool make_token(const std::string e, bool &expr_success) {
-	auto position = e.begin();
-	size_t i;
-
-	while (position != e.end()) {
-		std::smatch match;
-		/* Try all rules one by one. */
-		for (i = 0; i < NR_REGEX; i++) {
-			if (std::regex_search(position, e.end(), match, rules[i].regex,
-								  std::regex_constants::match_continuous)) {
-				if (rules[i].token_type == TK_NOTYPE) {
-					position += match[0].length();
-					break;
-				} else if (rules[i].token_type == '-') {
-					if (tokens.size() == 0 || notin(tokens.back().type, TK_DEC,
-													TK_OCT, TK_HEX, ')')) {
-						rules[i].token_type = TK_NEG;
-					}
-				}
-				tokens.emplace_back(Token{rules[i].token_type, match[0]});
-				position += match[0].length();
-				break;
-			}
+// Evaluate the newline-separated expressions in `input`, appending one line
+// per expression to `output`: the result, "error", or nothing for a blank
+// line.
+static void eval_lines(std::string_view input, expr::Context &ctx,
+					   expr::ProgramCache &cache, bool bigint,
+					   std::string &output) {
+	while (!input.empty()) {
+		size_t end = input.find('\n');
+		std::string_view line = input.substr(0, end);
+		input.remove_prefix(end == std::string_view::npos ? input.size()
+														  : end + 1);
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
 		}
 
-		if (i == NR_REGEX) {
-			expr_success = false;
-			int pos = static_cast<int>(position - e.begin());
-			std::cout << std::format("no match at position {}\n{}\n{:{}}^\n",
-									 pos, e, "", pos);
-			return false;
+		int64_t result;
+		expr::BigInt big;
+		switch (expr::evaluate(line, ctx, cache, result)) {
+		case expr::Status::Ok: {
+			char buf[24];
+			auto [last, ec] = std::to_chars(buf, buf + sizeof(buf), result);
+			output.append(buf, last);
+			break;
 		}
+		case expr::Status::Empty:
+			break;
+		case expr::Status::Overflow:
+			if (bigint && expr::evaluate_big(line, ctx, big) == expr::Status::Ok) {
+				output += big.ToString();
+				break;
+			}
+			[[fallthrough]];
+		default:
+			output += "error";
+			break;
+		}
+		output += '\n';
 	}
-	return true;
 }
 
-static bool check_parenthese(int l, int r, bool &expr_success) {
-	if (tokens[l].type != '(' || tokens[r].type != ')') {
+// Evaluate every line of `input_path` on `threads` threads and write the
+// results, in input order, to `output_path` or stdout if it is empty.
+static bool run_batch(const Options &options) {
+	const std::string &input_path = options.input;
+	const std::string &output_path = options.output;
+	int fd = open(input_path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		perror("open");
 		return false;
 	}
-	int i = l + 1, cnt = 1;
-	while (i < r) {
-		if (tokens[i].type == '(') {
-			cnt++;
-		} else if (tokens[i].type == ')') {
-			cnt--;
-		}
-		if (cnt == 0) {
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		perror("fstat");
+		close(fd);
+		return false;
+	}
+	size_t size = st.st_size;
+	const char *data = nullptr;
+	if (size > 0) {
+		void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			perror("mmap");
+			close(fd);
 			return false;
 		}
-		i++;
+		madvise(map, size, MADV_SEQUENTIAL);
+		data = static_cast<const char *>(map);
 	}
+	close(fd);
 
-	if (cnt != 1) {
-		expr_success = false;
+	FILE *out = output_path.empty() ? stdout : fopen(output_path.c_str(), "w");
+	if (!out) {
+		perror("fopen");
+		munmap(const_cast<char *>(data), size);
 		return false;
 	}
+	std::vector<char> out_buffer(kChunkBytes);
+	setvbuf(out, out_buffer.data(), _IOFBF, out_buffer.size());
 
-	return true;
-}
-
-static int eval(int l, int r, bool &expr_success) {
-	if (l > r) {
-		return 0;
-	} else if (l == r) {
-		switch (tokens[l].type) {
-		case TK_DEC:
-			return std::stoi(tokens[l].str);
-		case TK_OCT:
-			return std::stoi(tokens[l].str, nullptr, 8);
-		case TK_HEX:
-			return std::stoi(tokens[l].str, nullptr, 16);
-		default:
-			expr_success = false;
-			return 0;
+	// Split the input at the first newline after every kChunkBytes.
+	std::vector<std::string_view> inputs;
+	for (size_t begin = 0; begin < size;) {
+		size_t end = std::min(begin + kChunkBytes, size);
+		if (end < size) {
+			auto newline = static_cast<const char *>(
+				memchr(data + end, '\n', size - end));
+			end = newline ? newline - data + 1 : size;
 		}
-	} else if (check_parenthese(l, r, expr_success)) {
-		return eval(l + 1, r - 1, expr_success);
-	} else {
-		int op_pos = l, main_op_pos = l;
-		for (; op_pos <= r; ++op_pos) {
-			switch (tokens[op_pos].type) {
-			case '+':
-			case '-':
-				main_op_pos = op_pos;
-				break;
-			case '*':
-			case '/':
-				if (notin(tokens[main_op_pos].type, '+', '-')) {
-					main_op_pos = op_pos;
-				}
-				break;
-			case TK_NEG:
-				if (notin(tokens[main_op_pos].type, '+', '-', '*', '/')) {
-					main_op_pos = op_pos;
-				}
-				break;
-			case '(': {
-				int cnt = 1;
-				op_pos++;
-				while (op_pos <= r) {
-					if (tokens[op_pos].type == '(') {
-						cnt++;
-					} else if (tokens[op_pos].type == ')') {
-						cnt--;
-					}
-					op_pos++;
-					if (cnt == 0) {
-						op_pos--;
-						break;
-					}
-				}
-			}
-			default:
-				break;
+		inputs.emplace_back(data + begin, end - begin);
+		begin = end;
+	}
+
+	std::vector<Chunk> chunks(kWindow);
+	std::atomic<size_t> next{0};
+	std::atomic<size_t> written{0};
+	auto work = [&]() {
+		expr::Context ctx;
+		expr::ProgramCache cache(options.cache_entries);
+		for (size_t i = next++; i < inputs.size(); i = next++) {
+			// Wait for the writer to free the output buffer of chunk i.
+			for (size_t w = written.load(); i >= w + kWindow;
+				 w = written.load()) {
+				written.wait(w);
 			}
+			Chunk &chunk = chunks[i % kWindow];
+			chunk.output.clear();
+			eval_lines(inputs[i], ctx, cache, options.bigint, chunk.output);
+			chunk.ready = true;
+			chunk.ready.notify_one();
 		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < options.threads; ++t) {
+		workers.emplace_back(work);
+	}
 
-		if (notin(tokens[main_op_pos].type, TK_NEG, '+', '-', '*', '/')) {
-			expr_success = false;
-			return 0;
+	bool ok = true;
+	for (size_t i = 0; i < inputs.size(); ++i) {
+		Chunk &chunk = chunks[i % kWindow];
+		chunk.ready.wait(false);
+		if (fwrite(chunk.output.data(), 1, chunk.output.size(), out) !=
+			chunk.output.size()) {
+			perror("fwrite");
+			ok = false;
 		}
-		int lhs = eval(l, main_op_pos - 1, expr_success);
-		if (!expr_success)
-			return 0;
-		int rhs = eval(main_op_pos + 1, r, expr_success);
-		if (!expr_success)
-			return 0;
+		chunk.ready = false;
+		++written;
+		written.notify_all();
+	}
+	for (auto &worker : workers) {
+		worker.join();
+	}
 
-		switch (tokens[main_op_pos].type) {
-		case '+':
-			return lhs + rhs;
-		case '-':
-			return lhs - rhs;
-		case '*':
-			return lhs * rhs;
-		case '/':
-			if (rhs == 0) {
-				expr_success = false;
-				return 0;
-			}
-			return lhs / rhs;
-		}
+	if (fflush(out) != 0) {
+		perror("fflush");
+		ok = false;
 	}
-	return 0;
+	if (out != stdout) {
+		fclose(out);
+	}
+	if (data) {
+		munmap(const_cast<char *>(data), size);
+	}
+	return ok;
 }
 
-int main() {
+static void run_repl(const Options &options) {
+	expr::Context ctx;
+	expr::ProgramCache cache(options.cache_entries);
+	// Reused across queries, like the context, so that a query of a size
+	// seen before is read and evaluated without allocating.
+	std::string query;
+	std::ostreambuf_iterator<char> out(std::cout);
 	int cnt = 0;
 	while (1) {
-		bool expr_success = true;
-		tokens.clear();
-		std::cout << std::format("(expr {}) > ", cnt);
-		std::string query;
+		std::format_to(out, "(expr {}) > ", cnt);
 
 		if (!std::getline(std::cin, query) || query == "q") {
 			break;
 		}
-		make_token(query, expr_success);
-		if (!expr_success) {
+		int64_t result;
+		expr::BigInt big;
+		switch (expr::evaluate(query, ctx, cache, result)) {
+		case expr::Status::Ok:
+			std::format_to(out, "expr {}: {}\n", cnt, result);
+			std::cout.flush();
+			cnt++;
+			break;
+		case expr::Status::Overflow:
+			if (!options.bigint ||
+				expr::evaluate_big(query, ctx, big) != expr::Status::Ok) {
+				std::cout << "Integer overflow" << std::endl;
+				break;
+			}
+			std::format_to(out, "expr {}: {}\n", cnt, big.ToString());
+			std::cout.flush();
+			cnt++;
+			break;
+		case expr::Status::Empty:
+			break;
+		case expr::Status::Invalid:
+			std::cout << std::format("no match at position {}\n{}\n{:{}}^\n",
+									 ctx.error_pos, query, "", ctx.error_pos);
 			std::cout << "Invalid expression" << std::endl;
-			expr_success = true;
-			continue;
-		}
-		int result = eval(0, tokens.size() - 1, expr_success);
-		if (!expr_success) {
+			break;
+		case expr::Status::Failed:
 			std::cout << "Fail to evaluate the expression" << std::endl;
-			expr_success = true;
-			continue;
+			break;
+		}
+	}
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--batch" && i + 1 < argc) {
+			options.input = argv[++i];
+		} else if (arg == "--output" && i + 1 < argc) {
+			options.output = argv[++i];
+		} else if (arg == "--threads" && i + 1 < argc) {
+			options.threads = std::max(1, std::stoi(argv[++i]));
+		} else if (arg == "--cache" && i + 1 < argc) {
+			options.cache_entries = std::stoul(argv[++i]);
+		} else if (arg == "--no-bigint") {
+			options.bigint = false;
+		} else if (arg == "--help") {
+			std::cout
+				<< "Usage: " << argv[0] << " [options]\n"
+				<< "Without --batch, read expressions interactively.\n"
+				<< "Options:\n"
+				<< "  --batch <file>       Evaluate every line of <file>\n"
+				<< "  --output <file>      Write batch results to <file> "
+				   "(default: stdout)\n"
+				<< "  --threads <count>    Batch worker threads (default: "
+				   "all cores)\n"
+				<< "  --cache <entries>    Compiled expressions cached per "
+				   "thread (default: "
+				<< kCacheEntries << ", 0 to disable)\n"
+				<< "  --no-bigint          Fail on 64-bit overflow instead of "
+				   "evaluating\n"
+				<< "                       with arbitrary precision\n"
+				<< "  --help               Show this help\n";
+			return 0;
 		}
-		std::cout << std::format("expr {}: {}", cnt, result) << std::endl;
-		cnt++;
 	}
+
+	if (!options.input.empty()) {
+		return run_batch(options) ? 0 : 1;
+	}
+	run_repl(options);
 	return 0;
 }
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "arena.h"
+#include "lexer.h"
+#include "parser.h"
+#include <cstdint>
+#include <string_view>
+
+namespace expr {
+
+// Scratch state for evaluating expressions one after another. Tokens, nodes
+// and values live in an arena that is reset at the start of every
+// evaluation; it grows to the largest expression seen and is then reused,
+// so evaluating does not allocate. A context must not be shared between
+// threads; give each thread its own.
+struct Context {
+	Arena arena;
+	FixedVector<Token> tokens;
+	FixedVector<Node> nodes;
+	FixedVector<int64_t> values;
+	// Position of the first character not starting a token, after
+	// `evaluate` returned Status::Invalid.
+	size_t error_pos = 0;
+};
+
+// Lex `e` into `ctx.tokens`, releasing whatever the previous expression
+// left in `ctx`.
+inline Status tokenize(std::string_view e, Context &ctx) {
+	ctx.arena.Reset();
+	ctx.tokens = FixedVector<Token>(ctx.arena, e.size());
+	if (!make_token(e, ctx.tokens, ctx.error_pos)) {
+		return Status::Invalid;
+	}
+	return ctx.tokens.empty() ? Status::Empty : Status::Ok;
+}
+
+// Parse `ctx.tokens` into `ctx.nodes`.
+inline bool parse(Context &ctx) {
+	ctx.nodes = FixedVector<Node>(ctx.arena, ctx.tokens.size());
+	return parse(ctx.tokens, ctx.nodes);
+}
+
+// Lex, parse and evaluate `e`.
+inline Status evaluate(std::string_view e, Context &ctx, int64_t &result) {
+	if (Status status = tokenize(e, ctx); status != Status::Ok) {
+		return status;
+	}
+	if (!parse(ctx)) {
+		return Status::Failed;
+	}
+	ctx.values = FixedVector<int64_t>(ctx.arena, ctx.nodes.size());
+	return eval(ctx.nodes, ctx.values, result);
+}
+
+} // namespace expr
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace expr {
+
+enum {
+	TK_NOTYPE = 256,
+	TK_EQ,
+	TK_DEC,
+	TK_OCT,
+	TK_HEX,
+	TK_NEG,
+	TK_VAR,
+};
+
+// A token points into the expression it was read from, which must outlive
+// it.
+struct Token {
+	int type;
+	std::string_view str;
+};
+
+constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+constexpr bool is_oct_digit(char c) { return c >= '0' && c <= '7'; }
+
+constexpr bool is_hex_digit(char c) {
+	return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+constexpr bool is_ident_start(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+constexpr bool is_ident(char c) { return is_ident_start(c) || is_digit(c); }
+
+// A '-' is a negation unless it follows an operand.
+template <typename Tokens> constexpr bool is_operand_end(const Tokens &tokens) {
+	if (tokens.empty()) {
+		return false;
+	}
+	int type = tokens.back().type;
+	return type == TK_DEC || type == TK_OCT || type == TK_HEX ||
+		   type == TK_VAR || type == ')';
+}
+
+// Split `e` into `tokens` in a single pass. `tokens` is a std::vector, or a
+// FixedVector with room for `e.size()` tokens, which is the most there can
+// be. It is cleared first, so reusing the same one across expressions avoids
+// any allocation once it has grown. On failure, `error_pos` is the position
+// of the first character that does not start a token.
+template <typename Tokens>
+constexpr bool make_token(std::string_view e, Tokens &tokens,
+						  size_t &error_pos) {
+	tokens.clear();
+	size_t i = 0;
+	while (i < e.size()) {
+		size_t start = i;
+		int type;
+		switch (e[i]) {
+		case ' ':
+		case '\t':
+			++i;
+			continue;
+		case '+':
+		case '*':
+		case '/':
+		case '(':
+		case ')':
+			type = e[i++];
+			break;
+		case '-':
+			type = is_operand_end(tokens) ? '-' : int(TK_NEG);
+			++i;
+			break;
+		case '=':
+			if (i + 1 == e.size() || e[i + 1] != '=') {
+				error_pos = i;
+				return false;
+			}
+			type = TK_EQ;
+			i += 2;
+			break;
+		case '0':
+			++i;
+			if (i + 1 < e.size() && (e[i] == 'x' || e[i] == 'X') &&
+				is_hex_digit(e[i + 1])) {
+				type = TK_HEX;
+				i += 2;
+				while (i < e.size() && is_hex_digit(e[i])) {
+					++i;
+				}
+			} else if (i < e.size() && is_oct_digit(e[i])) {
+				type = TK_OCT;
+				while (i < e.size() && is_oct_digit(e[i])) {
+					++i;
+				}
+			} else {
+				type = TK_DEC;
+			}
+			break;
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+		case '8':
+		case '9':
+			type = TK_DEC;
+			while (i < e.size() && is_digit(e[i])) {
+				++i;
+			}
+			break;
+		default:
+			if (!is_ident_start(e[i])) {
+				error_pos = i;
+				return false;
+			}
+			type = TK_VAR;
+			while (i < e.size() && is_ident(e[i])) {
+				++i;
+			}
+			break;
+		}
+		tokens.push_back(Token{type, e.substr(start, i - start)});
+	}
+	return true;
+}
+
+} // namespace expr
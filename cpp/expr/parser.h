@@ -0,0 +1,270 @@
+#pragma once
+
+#include "lexer.h"
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+namespace expr {
+
+// A node of the syntax tree. `type` is TK_DEC for literals (whatever their
+// base), TK_BIG for literals too large for 64 bits, TK_VAR, TK_NEG, or the
+// token type of a binary operator.
+//
+// `parse` appends nodes in post-order: both children of a node precede it,
+// so the root is the last node and a front-to-back walk sees every operand
+// before the operator using it.
+struct Node {
+	int type;
+	int64_t value; // Literal value, or the token type of a TK_BIG literal.
+	int lhs;   // Index of the left (or only) operand, -1 for literals.
+	int rhs;   // Index of the right operand, -1 for literals and TK_NEG.
+	// Token of a literal or variable.
+	std::string_view str;
+};
+
+enum class Status {
+	Ok,
+	Empty,	  // Nothing but blanks.
+	Invalid,  // A character does not start any token.
+	Failed,	  // Malformed expression, unbound variable or division by zero.
+	Overflow, // Some intermediate result does not fit 64 bits; see bigint.h.
+};
+
+// Node type of a literal that does not fit 64 bits. It evaluates to
+// Status::Overflow, and `evaluate_big` reads it again in full.
+constexpr int TK_BIG = TK_VAR + 1;
+
+// Deeper nesting of brackets and negations is rejected rather than risking
+// the stack.
+constexpr int kMaxDepth = 4096;
+
+// Binding power of a binary operator, 0 for any other token.
+constexpr int precedence(int type) {
+	switch (type) {
+	case TK_EQ:
+		return 1;
+	case '+':
+	case '-':
+		return 2;
+	case '*':
+	case '/':
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+// Digits and base of a literal token of type `type`.
+constexpr std::string_view literal_digits(int type, std::string_view str,
+										  int &base) {
+	base = 10;
+	if (type == TK_OCT) {
+		base = 8;
+	} else if (type == TK_HEX) {
+		base = 16;
+		str.remove_prefix(2);
+	}
+	return str;
+}
+
+// Value of a digit of a literal, in any base up to 16.
+constexpr int digit_value(char c) {
+	return is_digit(c) ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+// Parse a literal token. Reports Status::Overflow instead of wrapping if it
+// does not fit.
+constexpr Status parse_literal(const Token &token, int64_t &value) {
+	int base;
+	std::string_view digits = literal_digits(token.type, token.str, base);
+	if (std::is_constant_evaluated()) {
+		// std::from_chars is not constexpr before C++23.
+		value = 0;
+		for (char c : digits) {
+			if (__builtin_mul_overflow(value, base, &value) ||
+				__builtin_add_overflow(value, digit_value(c), &value)) {
+				return Status::Overflow;
+			}
+		}
+		return Status::Ok;
+	}
+	auto [end, ec] = std::from_chars(digits.data(),
+									 digits.data() + digits.size(), value, base);
+	if (ec == std::errc::result_out_of_range) {
+		return Status::Overflow;
+	}
+	return ec == std::errc() && end == digits.data() + digits.size()
+			   ? Status::Ok
+			   : Status::Failed;
+}
+
+// Precedence-climbing parser building the tree in a single left-to-right
+// pass over the tokens.
+template <typename Nodes> struct Parser {
+	std::span<const Token> tokens;
+	Nodes &nodes;
+	size_t pos = 0;
+	int depth = 0;
+
+	constexpr int Push(Node node) {
+		nodes.push_back(node);
+		return static_cast<int>(nodes.size()) - 1;
+	}
+
+	// Parse a sequence of operands joined by binary operators binding at
+	// least as tightly as `min_prec`. Returns the index of its root, -1 on
+	// error.
+	constexpr int ParseBinary(int min_prec) {
+		int lhs = ParseUnary();
+		while (lhs >= 0 && pos < tokens.size()) {
+			int prec = precedence(tokens[pos].type);
+			if (prec < min_prec) {
+				break;
+			}
+			int op = tokens[pos++].type;
+			// Operators of the same precedence are left to the loop, which
+			// makes them left-associative.
+			int rhs = ParseBinary(prec + 1);
+			if (rhs < 0) {
+				return -1;
+			}
+			lhs = Push(Node{op, 0, lhs, rhs, {}});
+		}
+		return lhs;
+	}
+
+	// Parse a literal, a variable, a bracketed expression or a negation.
+	constexpr int ParseUnary() {
+		if (pos == tokens.size() || ++depth > kMaxDepth) {
+			return -1;
+		}
+		int index = -1;
+		const Token &token = tokens[pos++];
+		switch (token.type) {
+		case TK_DEC:
+		case TK_OCT:
+		case TK_HEX: {
+			int64_t value;
+			switch (parse_literal(token, value)) {
+			case Status::Ok:
+				index = Push(Node{TK_DEC, value, -1, -1, token.str});
+				break;
+			case Status::Overflow:
+				index = Push(Node{TK_BIG, token.type, -1, -1, token.str});
+				break;
+			default:
+				break;
+			}
+			break;
+		}
+		case TK_VAR:
+			index = Push(Node{TK_VAR, 0, -1, -1, token.str});
+			break;
+		case TK_NEG:
+			index = ParseUnary();
+			if (index >= 0) {
+				index = Push(Node{TK_NEG, 0, index, -1, {}});
+			}
+			break;
+		case '(':
+			index = ParseBinary(1);
+			if (pos == tokens.size() || tokens[pos++].type != ')') {
+				index = -1;
+			}
+			break;
+		default:
+			break;
+		}
+		--depth;
+		return index;
+	}
+};
+
+// Parse `tokens` into `nodes`, which is cleared first. `nodes` is a
+// std::vector, or a FixedVector with room for as many nodes as there are
+// tokens, since every node stems from a distinct token. Fails on a malformed
+// expression or trailing tokens.
+template <typename Nodes>
+constexpr bool parse(std::span<const Token> tokens, Nodes &nodes) {
+	nodes.clear();
+	Parser<Nodes> parser{tokens, nodes};
+	return parser.ParseBinary(1) >= 0 && parser.pos == tokens.size();
+}
+
+// Checked 64-bit arithmetic. Each returns true if the result overflowed, in
+// which case `result` holds it wrapped.
+constexpr bool neg_overflow(int64_t x, int64_t &result) {
+	return __builtin_sub_overflow(int64_t(0), x, &result);
+}
+
+constexpr bool div_overflow(int64_t x, int64_t y, int64_t &result) {
+	// The smallest value divided by -1 is the only quotient out of range,
+	// and it traps rather than wrapping.
+	bool overflow = (x == std::numeric_limits<int64_t>::min()) & (y == -1);
+	result = overflow ? x : x / y;
+	return overflow;
+}
+
+// Evaluate a tree built by `parse`. `values` is scratch space with room for
+// one value per node, reused across calls to avoid allocating. Fails on
+// division by zero and on variables, which need a compiled `Program` to be
+// bound.
+//
+// Overflows are only collected on the way and checked once at the end, so
+// the common case pays no more than a flag update per operator.
+template <typename Values>
+constexpr Status eval(std::span<const Node> nodes, Values &values,
+					  int64_t &result) {
+	values.resize(nodes.size());
+	bool overflow = false;
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const Node &node = nodes[i];
+		int64_t lhs = node.lhs >= 0 ? values[node.lhs] : 0;
+		int64_t rhs = node.rhs >= 0 ? values[node.rhs] : 0;
+		int64_t &value = values[i];
+		switch (node.type) {
+		case TK_DEC:
+			value = node.value;
+			break;
+		case TK_BIG:
+			value = 0;
+			overflow = true;
+			break;
+		case TK_VAR:
+			return Status::Failed;
+		case TK_NEG:
+			overflow |= neg_overflow(lhs, value);
+			break;
+		case TK_EQ:
+			value = lhs == rhs;
+			break;
+		case '+':
+			overflow |= __builtin_add_overflow(lhs, rhs, &value);
+			break;
+		case '-':
+			overflow |= __builtin_sub_overflow(lhs, rhs, &value);
+			break;
+		case '*':
+			overflow |= __builtin_mul_overflow(lhs, rhs, &value);
+			break;
+		case '/':
+			if (rhs == 0) {
+				// A divisor that wrapped to zero is not necessarily zero.
+				return overflow ? Status::Overflow : Status::Failed;
+			}
+			overflow |= div_overflow(lhs, rhs, value);
+			break;
+		}
+	}
+	if (nodes.empty()) {
+		return Status::Failed;
+	}
+	result = values.back();
+	return overflow ? Status::Overflow : Status::Ok;
+}
+
+} // namespace expr
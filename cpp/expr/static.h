@@ -0,0 +1,139 @@
+#pragma once
+
+// Expressions known at compile time: `eval` folds one into a constant and
+// `compile` turns one into bytecode held in arrays, so that nothing is
+// lexed or parsed at run time.
+//
+//   constexpr int64_t v = expr::eval("0x10 * (3 + 4)");
+//   constexpr auto f = expr::compile<"x * 3 + y">();
+//   expr::run(f, {{2, 5}}, result);
+//
+// A malformed expression fails to compile, with an error naming one of the
+// functions in `static_detail`.
+
+#include "bytecode.h"
+#include "lexer.h"
+#include "parser.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace expr {
+
+// String literal usable as a template argument.
+template <size_t N> struct FixedString {
+	char data[N];
+
+	constexpr FixedString(const char (&s)[N]) { std::copy(s, s + N, data); }
+
+	constexpr std::string_view view() const { return {data, N - 1}; }
+};
+
+// A `Program` whose sizes are fixed at compile time. Variable names view
+// into the template argument `compile` was given.
+template <size_t CodeSize, size_t MaxStack, size_t VariableCount>
+struct StaticProgram {
+	std::array<Instr, CodeSize> code;
+	std::array<std::string_view, VariableCount> variables;
+};
+
+namespace static_detail {
+
+// Not being constexpr, these end constant evaluation when called; the
+// compiler's error then names them.
+inline void invalid_character_in_expression() {}
+inline void malformed_expression() {}
+inline void expression_fails_to_evaluate() {}
+inline void expression_overflows_64_bits() {}
+
+constexpr void parse(std::string_view e, std::vector<Node> &nodes) {
+	std::vector<Token> tokens;
+	size_t error_pos = 0;
+	if (!make_token(e, tokens, error_pos)) {
+		invalid_character_in_expression();
+	}
+	if (!expr::parse(tokens, nodes)) {
+		malformed_expression();
+	}
+	for (const Node &node : nodes) {
+		if (node.type == TK_BIG) {
+			expression_overflows_64_bits();
+		}
+	}
+}
+
+constexpr Program compile(std::string_view e) {
+	std::vector<Node> nodes;
+	parse(e, nodes);
+	Program program;
+	expr::compile(nodes, program);
+	return program;
+}
+
+struct Shape {
+	size_t code_size;
+	size_t max_stack;
+	size_t variable_count;
+};
+
+constexpr Shape shape(std::string_view e) {
+	Program program = compile(e);
+	return Shape{program.code.size(), program.max_stack,
+				 program.variables.size()};
+}
+
+} // namespace static_detail
+
+// Value of `e`, which must be constant: free of variables and of division
+// by zero, and fitting 64 bits throughout.
+consteval int64_t eval(std::string_view e) {
+	std::vector<Node> nodes;
+	static_detail::parse(e, nodes);
+	std::vector<int64_t> values;
+	int64_t result = 0;
+	switch (eval(nodes, values, result)) {
+	case Status::Ok:
+		break;
+	case Status::Overflow:
+		static_detail::expression_overflows_64_bits();
+		break;
+	default:
+		static_detail::expression_fails_to_evaluate();
+		break;
+	}
+	return result;
+}
+
+// Compile `E` to bytecode at compile time.
+template <FixedString E> consteval auto compile() {
+	constexpr static_detail::Shape shape = static_detail::shape(E.view());
+	Program program = static_detail::compile(E.view());
+	StaticProgram<shape.code_size, shape.max_stack, shape.variable_count>
+		result{};
+	std::copy(program.code.begin(), program.code.end(), result.code.begin());
+	for (size_t i = 0; i < shape.variable_count; ++i) {
+		const std::string &name = program.variables[i];
+		result.variables[i] = E.view().substr(E.view().find(name), name.size());
+	}
+	return result;
+}
+
+// Run `program` with `variables[i]` bound to `program.variables[i]`, on a
+// stack of its own. Fails on division by zero and if a variable is left
+// unbound. Also usable in constant expressions.
+template <size_t CodeSize, size_t MaxStack, size_t VariableCount>
+constexpr Status
+run(const StaticProgram<CodeSize, MaxStack, VariableCount> &program,
+	std::span<const int64_t> variables, int64_t &result) {
+	if (variables.size() < VariableCount) {
+		return Status::Failed;
+	}
+	std::array<int64_t, MaxStack> stack{};
+	return run(program.code, variables, stack.data(), result);
+}
+
+} // namespace expr
@@ -0,0 +1,92 @@
+// Checks of compile-time evaluation through static.h. Most of them are
+// static_asserts, so building this file is already the test; running it
+// checks a program compiled at compile time against the VM.
+#include "bytecode.h"
+#include "lexer.h"
+#include "parser.h"
+#include "static.h"
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+constexpr int64_t kMax = std::numeric_limits<int64_t>::max();
+constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+
+static_assert(expr::eval("0x10 * (3 + 4)") == 112);
+static_assert(expr::eval("017 - -1 == 16") == 1);
+static_assert(expr::eval("7 / -2") == -3);
+static_assert(expr::eval("9223372036854775807") == kMax);
+static_assert(expr::eval("-9223372036854775807 - 1") == kMin);
+
+// Status of evaluating `e` through the constexpr lexer, parser and `eval`,
+// which `expr::eval` turns into compile errors.
+constexpr expr::Status eval_status(std::string_view e) {
+	std::vector<expr::Token> tokens;
+	std::vector<expr::Node> nodes;
+	std::vector<int64_t> values;
+	size_t error_pos = 0;
+	int64_t result = 0;
+	if (!expr::make_token(e, tokens, error_pos) ||
+		!expr::parse(tokens, nodes)) {
+		return expr::Status::Failed;
+	}
+	return expr::eval(nodes, values, result);
+}
+
+// Literals beyond 64 bits parse, and overflow rather than fail.
+static_assert(eval_status("9223372036854775808") == expr::Status::Overflow);
+static_assert(eval_status("-9223372036854775808") == expr::Status::Overflow);
+static_assert(eval_status("0x10000000000000000 * 0") ==
+			  expr::Status::Overflow);
+static_assert(eval_status("01000000000000000000000") ==
+			  expr::Status::Overflow);
+static_assert(eval_status("9223372036854775807 + 1") ==
+			  expr::Status::Overflow);
+static_assert(eval_status("1 / 0") == expr::Status::Failed);
+static_assert(eval_status("(1") == expr::Status::Failed);
+
+constexpr auto kProgram = expr::compile<"x * 3 + y">();
+static_assert(kProgram.variables.size() == 2);
+static_assert(kProgram.variables[0] == "x" && kProgram.variables[1] == "y");
+
+constexpr int64_t run_static(int64_t x, int64_t y) {
+	int64_t variables[] = {x, y};
+	int64_t result = 0;
+	if (expr::run(kProgram, variables, result) != expr::Status::Ok) {
+		return -1;
+	}
+	return result;
+}
+static_assert(run_static(2, 5) == 11);
+
+int main() {
+	// The same expression compiled at run time.
+	std::vector<expr::Token> tokens;
+	std::vector<expr::Node> nodes;
+	size_t error_pos = 0;
+	expr::Program program;
+	bool ok = expr::make_token("x * 3 + y", tokens, error_pos) &&
+			  expr::parse(tokens, nodes);
+	assert(ok);
+	(void)ok;
+	expr::compile(nodes, program);
+	assert(program.variables == std::vector<std::string>({"x", "y"}));
+
+	std::vector<int64_t> stack;
+	for (int64_t x : {int64_t(-7), int64_t(0), int64_t(12345), kMax / 3}) {
+		for (int64_t y : {int64_t(-1), int64_t(0), int64_t(99), kMin}) {
+			int64_t variables[] = {x, y};
+			int64_t expected = 0, result = 0;
+			expr::Status vm = expr::run(program, variables, stack, expected);
+			expr::Status fixed = expr::run(kProgram, variables, result);
+			assert(vm == fixed);
+			assert(vm != expr::Status::Ok || result == expected);
+		}
+	}
+
+	std::cout << "static expression tests passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// Latency histogram with log-linear buckets: values below 2^kSubBits have a
+// bucket each, and every power of two above is split into 2^kSubBits equal
+// buckets, so a recorded value is off by less than 1 / 2^kSubBits (1.6%).
+// Recording is a few arithmetic instructions and one increment.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+class Histogram {
+  private:
+	static constexpr int kSubBits = 6;
+	static constexpr uint64_t kSubBuckets = 1ULL << kSubBits;
+
+	std::vector<uint64_t> counts_;
+	uint64_t count_ = 0;
+	uint64_t sum_ = 0;
+	uint64_t min_ = std::numeric_limits<uint64_t>::max();
+	uint64_t max_ = 0;
+
+	static size_t index(uint64_t value) {
+		if (value < kSubBuckets) {
+			return value;
+		}
+		int shift = 63 - __builtin_clzll(value) - kSubBits;
+		return (shift + 1) * kSubBuckets + ((value >> shift) - kSubBuckets);
+	}
+
+	// Largest value that lands in bucket `i`.
+	static uint64_t upper(size_t i) {
+		if (i < kSubBuckets) {
+			return i;
+		}
+		int shift = i / kSubBuckets - 1;
+		uint64_t lower = (i % kSubBuckets + kSubBuckets) << shift;
+		return lower + ((1ULL << shift) - 1);
+	}
+
+  public:
+	Histogram() : counts_((64 - kSubBits + 1) * kSubBuckets) {}
+
+	void record(uint64_t value) {
+		++counts_[index(value)];
+		++count_;
+		sum_ += value;
+		min_ = std::min(min_, value);
+		max_ = std::max(max_, value);
+	}
+
+	void merge(const Histogram &other) {
+		for (size_t i = 0; i < counts_.size(); ++i) {
+			counts_[i] += other.counts_[i];
+		}
+		count_ += other.count_;
+		sum_ += other.sum_;
+		min_ = std::min(min_, other.min_);
+		max_ = std::max(max_, other.max_);
+	}
+
+	void reset() {
+		std::fill(counts_.begin(), counts_.end(), 0);
+		count_ = sum_ = max_ = 0;
+		min_ = std::numeric_limits<uint64_t>::max();
+	}
+
+	uint64_t count() const { return count_; }
+	uint64_t min() const { return count_ ? min_ : 0; }
+	uint64_t max() const { return max_; }
+	double mean() const { return count_ ? (double)sum_ / count_ : 0; }
+
+	// Value that `percent` percent of recorded values do not exceed, rounded
+	// up to the end of its bucket but never past the maximum.
+	uint64_t percentile(double percent) const {
+		if (count_ == 0) {
+			return 0;
+		}
+		uint64_t rank =
+			std::max<uint64_t>(1, (uint64_t)std::ceil(percent / 100.0 * count_));
+		uint64_t seen = 0;
+		for (size_t i = 0; i < counts_.size(); ++i) {
+			seen += counts_[i];
+			if (seen >= rank) {
+				return std::min(upper(i), max_);
+			}
+		}
+		return max_;
+	}
+};
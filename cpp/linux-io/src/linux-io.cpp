@@ -1,23 +1,171 @@
+#include <algorithm>
+#include <atomic>
+#include <barrier>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <fcntl.h>
+#include <functional>
 #include <iostream>
 #include <libaio.h>
 #include <liburing.h>
 #include <linux/fs.h>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
 #include <string>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/uio.h>
+#include <sys/utsname.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
+#include "histogram.h"
+#include "report.h"
+#include "stream.h"
+#include "uring.h"
+#include "workload.h"
+
+// How SyncIO makes a commit's writes durable: fsync or fdatasync after
+// them, writing through an O_DSYNC descriptor, sync_file_range over the
+// range written (which flushes data but neither metadata nor the device
+// cache), or io_uring writes linked to an fdatasync.
+enum class SyncMode { Fsync, Fdatasync, Dsync, SyncFileRange, UringLink };
+
+static bool parse_sync_mode(const std::string &name, SyncMode &mode) {
+	if (name == "fsync") {
+		mode = SyncMode::Fsync;
+	} else if (name == "fdatasync") {
+		mode = SyncMode::Fdatasync;
+	} else if (name == "dsync") {
+		mode = SyncMode::Dsync;
+	} else if (name == "sync_file_range") {
+		mode = SyncMode::SyncFileRange;
+	} else if (name == "uring") {
+		mode = SyncMode::UringLink;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static const char *sync_mode_name(SyncMode mode) {
+	switch (mode) {
+	case SyncMode::Fsync:
+		return "fsync";
+	case SyncMode::Fdatasync:
+		return "fdatasync";
+	case SyncMode::Dsync:
+		return "O_DSYNC";
+	case SyncMode::SyncFileRange:
+		return "sync_file_range";
+	case SyncMode::UringLink:
+		return "uring linked";
+	}
+	return "?";
+}
+
+// Page-cache state of the test file before each engine runs: dropped, so
+// that every engine starts from the device; warmed, read ahead into the
+// cache; or kept as the previous engine left it.
+enum class CacheMode { Drop, Warm, Keep };
+
+static bool parse_cache_mode(const std::string &name, CacheMode &mode) {
+	if (name == "drop") {
+		mode = CacheMode::Drop;
+	} else if (name == "warm") {
+		mode = CacheMode::Warm;
+	} else if (name == "keep") {
+		mode = CacheMode::Keep;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static const char *cache_mode_name(CacheMode mode) {
+	switch (mode) {
+	case CacheMode::Drop:
+		return "drop";
+	case CacheMode::Warm:
+		return "warm";
+	case CacheMode::Keep:
+		return "keep";
+	}
+	return "?";
+}
+
 // Common configuration
 struct Config {
 	std::string filename = "testfile.dat";
 	size_t file_size = 1ULL << 30; // 1GB
 	size_t block_size = 4096;
 	size_t num_operations = 1000;
+	// I/Os kept in flight by the asynchronous engines.
+	size_t iodepth = 1;
+	// Queue depths to sweep, each in a run of its own. Empty for a single run
+	// at `iodepth`.
+	std::vector<size_t> sweep;
+	// Workers, each with its own engine instance, buffers and slice of the
+	// file, and each performing `num_operations` I/Os.
+	size_t jobs = 1;
+	// Worker counts to sweep, like `sweep`.
+	std::vector<size_t> jobs_sweep;
+	// Pin worker `i` to the `i`-th CPU the process may run on, modulo their
+	// number.
+	bool pin = false;
+	// madvise() advice for MmapIO, or -1 to follow the access pattern.
+	int madvise = -1;
+	// Map the file with MAP_POPULATE, faulting it all in up front.
+	bool populate = false;
+	// RWF_* flags for VectoredIO. RWF_HIPRI makes it open the file with
+	// O_DIRECT, as polling only applies to direct I/O.
+	int rwf_flags = 0;
+	// Durability modes to measure, each as an engine of its own, and the
+	// writes per commit.
+	std::vector<SyncMode> sync_modes;
+	size_t sync_every = 1;
+	Pattern pattern = Pattern::Sequential;
+	// Files each worker reads and writes side by side, as equal parts of its
+	// slice of the test file.
+	size_t files = 1;
+	// Provided buffers of IOUringBufRing, or 0 for as many as the queue
+	// depth.
+	size_t buf_ring = 0;
+	// Percentage of reads in an extra mixed phase, or -1 for none.
+	int rwmix = -1;
+	uint64_t seed = 1;
+	double zipf_theta = 0.99;
+	// Seconds each phase runs for, cycling through the I/Os, or 0 to run
+	// through them once; seconds at its start left out of the results; and
+	// I/Os per second across workers, or 0 for as fast as possible.
+	double runtime = 0;
+	double ramp = 0;
+	double rate = 0;
+	// Seconds between progress reports of time-based runs, or 0 for none.
+	double interval = 1;
+	// Setups each io_uring engine runs in, and optional IORING_SETUP_* flags
+	// tried on top of them.
+	std::vector<RingMode> ring_modes = {RingMode::SQPoll};
+	unsigned ring_flags = 0;
+	CacheMode cache = CacheMode::Drop;
+	// Keep the test file after the run, and use an existing one if it
+	// passes `Utils::valid_test_file`.
+	bool reuse = false;
+	// Results on stdout as JSON or CSV, with the text sent to stderr.
+	Output output = Output::Text;
+	// JSON results of an earlier run to compare against, and the change in
+	// percent past which a difference is a regression.
+	std::string compare;
+	double threshold = 10;
 	bool verbose = false;
 };
 
@@ -26,46 +174,198 @@ class IOMethod {
   public:
 	virtual ~IOMethod() = default;
 	virtual bool init(const Config &config) = 0;
-	virtual bool run_read() = 0;
-	virtual bool run_write() = 0;
+	// Perform the I/Os `stream` hands out, reporting each completion to it.
+	virtual bool run(Stream &stream) = 0;
 	virtual void cleanup() = 0;
 	virtual std::string name() const = 0;
+	// Whether the engine keeps `Config::iodepth` I/Os in flight. Synchronous
+	// engines always run at depth 1.
+	virtual bool async() const { return false; }
+	// Bytes of I/O buffers a worker holds with `config`.
+	virtual size_t buffer_bytes(const Config &config) const {
+		return config.block_size;
+	}
 };
 
 // Utility functions
 class Utils {
   public:
+	// Create `filename` holding `size` bytes of incompressible data. The file
+	// is preallocated, then filled in kFillChunk writes by several threads
+	// taking chunks in turn. Each thread generates one chunk of pseudo-random
+	// data and stamps the start of every 4 KB block with its position, so
+	// that no two blocks of the file are alike either.
 	static bool create_test_file(const std::string &filename, size_t size) {
+		static constexpr size_t kFillChunk = 1 << 20;
+
 		int fd = open(filename.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
 		if (fd < 0) {
 			perror("open");
 			return false;
 		}
+		if (fallocate(fd, 0, 0, size) != 0 && errno != EOPNOTSUPP) {
+			perror("fallocate");
+			close(fd);
+			return false;
+		}
 
-		char *buffer = new char[4096];
-		memset(buffer, 'A', 4096);
+		size_t chunks = (size + kFillChunk - 1) / kFillChunk;
+		std::atomic<size_t> next{0};
+		std::atomic<bool> ok{true};
+		auto fill = [&]() {
+			std::vector<uint64_t> buffer(kFillChunk / sizeof(uint64_t));
+			uint64_t state = next;
+			for (uint64_t &word : buffer) {
+				word = scatter(state++);
+			}
+			for (size_t chunk = next++; chunk < chunks && ok; chunk = next++) {
+				off_t offset = chunk * kFillChunk;
+				for (size_t word = 0; word < buffer.size(); word += 512) {
+					buffer[word] = scatter(offset + word * sizeof(uint64_t));
+				}
+				size_t length = std::min(kFillChunk, size - offset);
+				const char *data = reinterpret_cast<const char *>(buffer.data());
+				while (length > 0) {
+					ssize_t written = pwrite(fd, data, length, offset);
+					if (written <= 0) {
+						perror("pwrite");
+						ok = false;
+						return;
+					}
+					data += written;
+					offset += written;
+					length -= written;
+				}
+			}
+		};
 
-		size_t remaining = size;
-		while (remaining > 0) {
-			size_t to_write = std::min(remaining, (size_t)4096);
-			if (write(fd, buffer, to_write) != (ssize_t)to_write) {
-				perror("write");
-				close(fd);
-				delete[] buffer;
-				return false;
+		size_t threads = std::clamp<size_t>(std::thread::hardware_concurrency(),
+											1, std::min<size_t>(8, chunks));
+		std::vector<std::thread> fillers;
+		for (size_t i = 1; i < threads; ++i) {
+			fillers.emplace_back(fill);
+		}
+		fill();
+		for (std::thread &filler : fillers) {
+			filler.join();
+		}
+
+		close(fd);
+		return ok;
+	}
+
+	// Whether `filename` is a test file that can be reused for `size`: a
+	// regular file of that size with all of its blocks allocated.
+	static bool valid_test_file(const std::string &filename, size_t size) {
+		struct stat st;
+		if (stat(filename.c_str(), &st) != 0) {
+			return false;
+		}
+		return S_ISREG(st.st_mode) && (size_t)st.st_size == size &&
+			   (size_t)st.st_blocks * 512 >= size;
+	}
+
+	// Put the page cache of `filename` in the state `mode` asks for. Dirty
+	// pages are written back first, as POSIX_FADV_DONTNEED leaves them.
+	static bool set_cache_state(const std::string &filename, size_t size,
+								CacheMode mode) {
+		if (mode == CacheMode::Keep) {
+			return true;
+		}
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			perror("open cache");
+			return false;
+		}
+		bool ok = true;
+		if (mode == CacheMode::Drop) {
+			if (fdatasync(fd) != 0) {
+				perror("fdatasync cache");
+				ok = false;
+			} else if (int ret =
+						   posix_fadvise(fd, 0, size, POSIX_FADV_DONTNEED)) {
+				// posix_fadvise returns the error rather than setting errno.
+				fprintf(stderr, "posix_fadvise DONTNEED: %s\n", strerror(ret));
+				ok = false;
+			}
+		} else {
+			// readahead blocks until the reads are issued; WILLNEED is the
+			// portable fallback.
+			if (readahead(fd, 0, size) != 0) {
+				if (int ret = posix_fadvise(fd, 0, size, POSIX_FADV_WILLNEED)) {
+					fprintf(stderr, "posix_fadvise WILLNEED: %s\n",
+							strerror(ret));
+					ok = false;
+				}
 			}
-			remaining -= to_write;
 		}
+		close(fd);
+		return ok;
+	}
 
+	// Fraction of `filename` resident in the page cache, or -1 if unknown.
+	// Uses cachestat where the kernel has it, mincore on a mapping otherwise.
+	static double resident(const std::string &filename, size_t size) {
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return -1;
+		}
+		long page = sysconf(_SC_PAGESIZE);
+		size_t pages = (size + page - 1) / page;
+		double fraction = -1;
+#ifdef __NR_cachestat
+		struct {
+			uint64_t off, len;
+		} range = {0, size};
+		struct {
+			uint64_t nr_cache, nr_dirty, nr_writeback, nr_evicted,
+				nr_recently_evicted;
+		} stat;
+		if (syscall(__NR_cachestat, fd, &range, &stat, 0) == 0) {
+			fraction = (double)stat.nr_cache / pages;
+		}
+#endif
+		if (fraction < 0) {
+			void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+			if (map != MAP_FAILED) {
+				std::vector<unsigned char> vec(pages);
+				if (mincore(map, size, vec.data()) == 0) {
+					size_t count = 0;
+					for (unsigned char v : vec) {
+						count += v & 1;
+					}
+					fraction = (double)count / pages;
+				}
+				munmap(map, size);
+			}
+		}
 		close(fd);
-		delete[] buffer;
-		return true;
+		return fraction;
+	}
+
+	// Queue depth an asynchronous engine actually runs at: there is no point
+	// in more slots than operations.
+	static size_t iodepth(const Config &config) {
+		return std::max<size_t>(1, std::min(config.iodepth,
+											config.num_operations));
 	}
 
+	// Monotonic time in nanoseconds, for per-I/O latencies.
+	static uint64_t now_ns() { return monotonic_ns(); }
+
 	static bool remove_file(const std::string &filename) {
 		return unlink(filename.c_str()) == 0;
 	}
 
+	// User and system CPU time of the process in milliseconds, counting the
+	// io_uring SQPOLL threads, which belong to it.
+	static double cpu_ms() {
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+			   (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+	}
+
 	template <typename Func> static double benchmark(Func &&func) {
 		auto start = std::chrono::high_resolution_clock::now();
 		if (!func()) {
@@ -87,52 +387,29 @@ class BufferedIO : public IOMethod {
 	bool init(const Config &config) override {
 		config_ = config;
 		buffer_ = new char[config_.block_size];
-		return true;
-	}
-
-	bool run_read() override {
-		fd_ = open(config_.filename.c_str(), O_RDONLY);
+		memset(buffer_, 'B', config_.block_size);
+		fd_ = open(config_.filename.c_str(), O_RDWR);
 		if (fd_ < 0) {
-			perror("open read");
+			perror("open");
 			return false;
 		}
-
-		for (size_t i = 0; i < config_.num_operations; ++i) {
-			off_t offset = (i * config_.block_size) %
-						   (config_.file_size - config_.block_size);
-			if (lseek(fd_, offset, SEEK_SET) < 0) {
-				perror("lseek");
-				return false;
-			}
-			if (read(fd_, buffer_, config_.block_size) !=
-				(ssize_t)config_.block_size) {
-				perror("read");
-				return false;
-			}
-		}
 		return true;
 	}
 
-	bool run_write() override {
-		fd_ = open(config_.filename.c_str(), O_WRONLY);
-		if (fd_ < 0) {
-			perror("open write");
-			return false;
-		}
-
-		memset(buffer_, 'B', config_.block_size);
-		for (size_t i = 0; i < config_.num_operations; ++i) {
-			off_t offset = (i * config_.block_size) %
-						   (config_.file_size - config_.block_size);
-			if (lseek(fd_, offset, SEEK_SET) < 0) {
+	bool run(Stream &stream) override {
+		uint64_t due;
+		while (const IO *io = stream.next(due)) {
+			if (lseek(fd_, io->offset, SEEK_SET) < 0) {
 				perror("lseek");
 				return false;
 			}
-			if (write(fd_, buffer_, config_.block_size) !=
-				(ssize_t)config_.block_size) {
-				perror("write");
+			ssize_t ret = io->write ? write(fd_, buffer_, config_.block_size)
+									: read(fd_, buffer_, config_.block_size);
+			if (ret != (ssize_t)config_.block_size) {
+				perror(io->write ? "write" : "read");
 				return false;
 			}
+			stream.complete(due, Utils::now_ns());
 		}
 		return true;
 	}
@@ -163,52 +440,29 @@ class DirectIO : public IOMethod {
 			perror("posix_memalign");
 			return false;
 		}
-		return true;
-	}
-
-	bool run_read() override {
-		fd_ = open(config_.filename.c_str(), O_RDONLY | O_DIRECT);
+		memset(buffer_, 'C', config_.block_size);
+		fd_ = open(config_.filename.c_str(), O_RDWR | O_DIRECT);
 		if (fd_ < 0) {
-			perror("open direct read");
+			perror("open direct");
 			return false;
 		}
-
-		for (size_t i = 0; i < config_.num_operations; ++i) {
-			off_t offset = (i * config_.block_size) %
-						   (config_.file_size - config_.block_size);
-			if (lseek(fd_, offset, SEEK_SET) < 0) {
-				perror("lseek");
-				return false;
-			}
-			if (read(fd_, buffer_, config_.block_size) !=
-				(ssize_t)config_.block_size) {
-				perror("read");
-				return false;
-			}
-		}
 		return true;
 	}
 
-	bool run_write() override {
-		fd_ = open(config_.filename.c_str(), O_WRONLY | O_DIRECT);
-		if (fd_ < 0) {
-			perror("open direct write");
-			return false;
-		}
-
-		memset(buffer_, 'C', config_.block_size);
-		for (size_t i = 0; i < config_.num_operations; ++i) {
-			off_t offset = (i * config_.block_size) %
-						   (config_.file_size - config_.block_size);
-			if (lseek(fd_, offset, SEEK_SET) < 0) {
+	bool run(Stream &stream) override {
+		uint64_t due;
+		while (const IO *io = stream.next(due)) {
+			if (lseek(fd_, io->offset, SEEK_SET) < 0) {
 				perror("lseek");
 				return false;
 			}
-			if (write(fd_, buffer_, config_.block_size) !=
-				(ssize_t)config_.block_size) {
-				perror("write");
+			ssize_t ret = io->write ? write(fd_, buffer_, config_.block_size)
+									: read(fd_, buffer_, config_.block_size);
+			if (ret != (ssize_t)config_.block_size) {
+				perror(io->write ? "write" : "read");
 				return false;
 			}
+			stream.complete(due, Utils::now_ns());
 		}
 		return true;
 	}
@@ -227,146 +481,350 @@ class DirectIO : public IOMethod {
 	std::string name() const override { return "Direct IO"; }
 };
 
-// Linux AIO
-class LinuxAIO : public IOMethod {
+// Memory-mapped IO: reads and writes are copies from and to a shared mapping
+// of the file, so that the cost is in page faults and writeback rather than
+// system calls.
+class MmapIO : public IOMethod {
   private:
 	Config config_;
 	int fd_ = -1;
 	char *buffer_ = nullptr;
-	io_context_t ctx_ = 0;
+	char *map_ = nullptr;
 
   public:
 	bool init(const Config &config) override {
 		config_ = config;
-		buffer_ = new char[config_.block_size * config_.num_operations];
-		if (io_setup(config_.num_operations, &ctx_) < 0) {
-			perror("io_setup");
+		buffer_ = new char[config_.block_size];
+		memset(buffer_, 'M', config_.block_size);
+		fd_ = open(config_.filename.c_str(), O_RDWR);
+		if (fd_ < 0) {
+			perror("open mmap");
 			return false;
 		}
-		return true;
-	}
 
-	bool run_read() override {
-		fd_ = open(config_.filename.c_str(), O_RDONLY | O_DIRECT);
-		if (fd_ < 0) {
-			perror("open aio read");
+		int flags = MAP_SHARED | (config_.populate ? MAP_POPULATE : 0);
+		void *map = mmap(nullptr, config_.file_size, PROT_READ | PROT_WRITE,
+						 flags, fd_, 0);
+		if (map == MAP_FAILED) {
+			perror("mmap");
 			return false;
 		}
+		map_ = static_cast<char *>(map);
 
-		std::vector<iocb *> iocbs(config_.num_operations);
-		std::vector<iocb> cb(config_.num_operations);
+		int advice = config_.madvise;
+		if (advice < 0) {
+			advice = config_.pattern == Pattern::Sequential ? MADV_SEQUENTIAL
+															: MADV_RANDOM;
+		}
+		if (::madvise(map_, config_.file_size, advice) != 0) {
+			perror("madvise");
+		}
+		return true;
+	}
+
+	bool run(Stream &stream) override {
+		uint64_t due;
+		while (const IO *io = stream.next(due)) {
+			if (io->write) {
+				memcpy(map_ + io->offset, buffer_, config_.block_size);
+			} else {
+				memcpy(buffer_, map_ + io->offset, config_.block_size);
+			}
+			stream.complete(due, Utils::now_ns());
+		}
+		return true;
+	}
 
-		for (size_t i = 0; i < config_.num_operations; ++i) {
-			off_t offset = (i * config_.block_size) %
-						   (config_.file_size - config_.block_size);
-			memset(&cb[i], 0, sizeof(iocb));
-			cb[i].aio_fildes = fd_;
-			cb[i].aio_lio_opcode = IO_CMD_PREAD;
-			cb[i].u.c.buf = buffer_ + i * config_.block_size;
-			cb[i].u.c.nbytes = config_.block_size;
-			cb[i].u.c.offset = offset;
-			iocbs[i] = &cb[i];
+	void cleanup() override {
+		if (map_) {
+			munmap(map_, config_.file_size);
+			map_ = nullptr;
+		}
+		if (fd_ >= 0) {
+			close(fd_);
+			fd_ = -1;
 		}
+		delete[] buffer_;
+		buffer_ = nullptr;
+	}
+
+	std::string name() const override { return "Mmap IO"; }
+	size_t buffer_bytes(const Config &) const override { return 0; }
+};
 
-		if (io_submit(ctx_, config_.num_operations, iocbs.data()) !=
-			(int)config_.num_operations) {
-			perror("io_submit");
+// preadv2/pwritev2: reads take `Config::rwf_flags`, and runs of writes to
+// adjacent blocks are coalesced into a single pwritev2 of up to kMaxBatch
+// blocks. A read that RWF_NOWAIT turns away, because it would block, is
+// retried without the flag.
+class VectoredIO : public IOMethod {
+  private:
+	static constexpr size_t kMaxBatch = 64;
+
+	Config config_;
+	int fd_ = -1;
+	char *buffer_ = nullptr;
+	std::vector<iovec> iovecs_;
+	size_t retries_ = 0;
+
+  public:
+	bool init(const Config &config) override {
+		config_ = config;
+		if (posix_memalign((void **)&buffer_, 4096, config_.block_size) != 0) {
+			perror("posix_memalign");
 			return false;
 		}
+		memset(buffer_, 'V', config_.block_size);
+		// Every block of a batch is written from the same buffer.
+		iovecs_.assign(kMaxBatch, iovec{buffer_, config_.block_size});
 
-		std::vector<io_event> events(config_.num_operations);
-		if (io_getevents(ctx_, config_.num_operations, config_.num_operations,
-						 events.data(),
-						 nullptr) != (long)config_.num_operations) {
-			perror("io_getevents");
+		int flags = O_RDWR;
+		if (config_.rwf_flags & RWF_HIPRI) {
+			flags |= O_DIRECT;
+		}
+		fd_ = open(config_.filename.c_str(), flags);
+		if (fd_ < 0) {
+			perror("open vectored");
 			return false;
 		}
+		return true;
+	}
+
+	bool run(Stream &stream) override {
+		int write_flags = config_.rwf_flags & RWF_HIPRI;
+		uint64_t due[kMaxBatch];
+		while (const IO *io = stream.next(due[0])) {
+			if (!io->write) {
+				ssize_t ret = preadv2(fd_, iovecs_.data(), 1, io->offset,
+									  config_.rwf_flags);
+				if (ret < 0 && errno == EAGAIN &&
+					(config_.rwf_flags & RWF_NOWAIT)) {
+					++retries_;
+					ret = preadv2(fd_, iovecs_.data(), 1, io->offset,
+								  config_.rwf_flags & ~RWF_NOWAIT);
+				}
+				if (ret != (ssize_t)config_.block_size) {
+					perror("preadv2");
+					return false;
+				}
+				stream.complete(due[0], Utils::now_ns());
+				continue;
+			}
 
+			size_t batch = 1;
+			for (const IO *more = stream.peek();
+				 more && batch < kMaxBatch && more->write &&
+				 more->offset ==
+					 io->offset + (off_t)(batch * config_.block_size);
+				 more = stream.peek()) {
+				stream.next(due[batch++]);
+			}
+			ssize_t ret =
+				pwritev2(fd_, iovecs_.data(), batch, io->offset, write_flags);
+			if (ret != (ssize_t)(batch * config_.block_size)) {
+				perror("pwritev2");
+				return false;
+			}
+			// Every write of the batch completes with it.
+			uint64_t now = Utils::now_ns();
+			for (size_t j = 0; j < batch; ++j) {
+				stream.complete(due[j], now);
+			}
+		}
 		return true;
 	}
 
-	bool run_write() override {
-		fd_ = open(config_.filename.c_str(), O_WRONLY | O_DIRECT);
-		if (fd_ < 0) {
-			perror("open aio write");
-			return false;
+	void cleanup() override {
+		if (config_.verbose && retries_) {
+			fprintf(stderr, "%s: %zu reads retried without RWF_NOWAIT\n",
+					name().c_str(), retries_);
 		}
+		retries_ = 0;
+		if (fd_ >= 0) {
+			close(fd_);
+			fd_ = -1;
+		}
+		free(buffer_);
+		buffer_ = nullptr;
+	}
 
-		memset(buffer_, 'D', config_.block_size * config_.num_operations);
+	std::string name() const override { return "Vectored IO"; }
+};
 
-		std::vector<iocb *> iocbs(config_.num_operations);
-		std::vector<iocb> cb(config_.num_operations);
+// Linux AIO
+class LinuxAIO : public IOMethod {
+  private:
+	Config config_;
+	int fd_ = -1;
+	char *buffer_ = nullptr;
+	io_context_t ctx_ = 0;
 
-		for (size_t i = 0; i < config_.num_operations; ++i) {
-			off_t offset = (i * config_.block_size) %
-						   (config_.file_size - config_.block_size);
-			memset(&cb[i], 0, sizeof(iocb));
-			cb[i].aio_fildes = fd_;
-			cb[i].aio_lio_opcode = IO_CMD_PWRITE;
-			cb[i].u.c.buf = buffer_ + i * config_.block_size;
-			cb[i].u.c.nbytes = config_.block_size;
-			cb[i].u.c.offset = offset;
-			iocbs[i] = &cb[i];
+  public:
+	bool init(const Config &config) override {
+		config_ = config;
+		size_t depth = Utils::iodepth(config_);
+		if (posix_memalign((void **)&buffer_, 4096,
+						   config_.block_size * depth) != 0) {
+			perror("posix_memalign");
+			return false;
 		}
-
-		if (io_submit(ctx_, config_.num_operations, iocbs.data()) !=
-			(int)config_.num_operations) {
-			perror("io_submit");
+		memset(buffer_, 'D', config_.block_size * depth);
+		fd_ = open(config_.filename.c_str(), O_RDWR | O_DIRECT);
+		if (fd_ < 0) {
+			perror("open aio");
 			return false;
 		}
-
-		std::vector<io_event> events(config_.num_operations);
-		if (io_getevents(ctx_, config_.num_operations, config_.num_operations,
-						 events.data(),
-						 nullptr) != (long)config_.num_operations) {
-			perror("io_getevents");
+		int ret = io_setup(depth, &ctx_);
+		if (ret < 0) {
+			fprintf(stderr, "io_setup: %s\n", strerror(-ret));
 			return false;
 		}
-
 		return true;
 	}
 
+	// Keep `iodepth` I/Os in flight until the stream runs out. Each slot owns
+	// an iocb, a block of the buffer and the due time of its I/O, and is
+	// refilled with the next I/O as soon as its own completes. The slot
+	// travels in the iocb's data.
+	bool run(Stream &stream) override {
+		size_t depth = Utils::iodepth(config_);
+		std::vector<iocb> cbs(depth);
+		std::vector<uint64_t> due(depth);
+		std::vector<iocb *> pending;
+		std::vector<io_event> events(depth);
+		size_t inflight = 0;
+		bool failed = false;
+
+		auto submit = [&]() {
+			if (pending.empty() || failed) {
+				return;
+			}
+			int ret = io_submit(ctx_, pending.size(), pending.data());
+			if (ret != (int)pending.size()) {
+				fprintf(stderr, "io_submit: %s\n",
+						ret < 0 ? strerror(-ret) : "short submission");
+				failed = true;
+			}
+			pending.clear();
+		};
+
+		auto prep = [&](size_t slot) {
+			const IO *io = stream.next(due[slot], submit);
+			if (!io) {
+				return;
+			}
+			iocb &cb = cbs[slot];
+			memset(&cb, 0, sizeof(iocb));
+			cb.data = reinterpret_cast<void *>(slot);
+			cb.aio_fildes = fd_;
+			cb.aio_lio_opcode = io->write ? IO_CMD_PWRITE : IO_CMD_PREAD;
+			cb.u.c.buf = buffer_ + slot * config_.block_size;
+			cb.u.c.nbytes = config_.block_size;
+			cb.u.c.offset = io->offset;
+			pending.push_back(&cb);
+			++inflight;
+		};
+
+		for (size_t slot = 0; slot < depth; ++slot) {
+			prep(slot);
+		}
+		while (inflight > 0) {
+			submit();
+			if (failed) {
+				return false;
+			}
+			int n = io_getevents(ctx_, 1, depth, events.data(), nullptr);
+			if (n < 0) {
+				fprintf(stderr, "io_getevents: %s\n", strerror(-n));
+				return false;
+			}
+			uint64_t now = Utils::now_ns();
+			for (int i = 0; i < n; ++i) {
+				if ((long)events[i].res < 0) {
+					fprintf(stderr, "AIO error: %s\n",
+							strerror(-(long)events[i].res));
+					return false;
+				}
+				size_t slot = reinterpret_cast<size_t>(events[i].data);
+				stream.complete(due[slot], now);
+				--inflight;
+				prep(slot);
+			}
+		}
+		return !failed;
+	}
+
 	void cleanup() override {
 		if (fd_ >= 0) {
 			close(fd_);
 			fd_ = -1;
 		}
-		delete[] buffer_;
+		free(buffer_);
 		buffer_ = nullptr;
-		io_destroy(ctx_);
-		ctx_ = 0;
+		if (ctx_) {
+			io_destroy(ctx_);
+			ctx_ = 0;
+		}
 	}
 
 	std::string name() const override { return "Linux AIO"; }
+	bool async() const override { return true; }
+	size_t buffer_bytes(const Config &config) const override {
+		return Utils::iodepth(config) * config.block_size;
+	}
 };
 
+// Set up `ring` for `engine` as `config` asks, warning about optional flags
+// the kernel rejected.
+static bool setup_ring(struct io_uring &ring, unsigned entries, RingMode mode,
+					   const Config &config, const std::string &engine) {
+	unsigned used;
+	int ret = init_ring(ring, entries, mode, config.ring_flags, used);
+	if (ret < 0) {
+		fprintf(stderr, "io_uring_queue_init_params: %s\n", strerror(-ret));
+		return false;
+	}
+	if (used != config.ring_flags) {
+		fprintf(stderr, "%s: kernel rejected flags %s, using %s\n",
+				engine.c_str(), ring_flag_names(config.ring_flags).c_str(),
+				ring_flag_names(used).c_str());
+	}
+	return true;
+}
+
 class IOUring : public IOMethod {
   private:
 	Config config_;
+	RingMode mode_;
 	int fd_ = -1;
 	char *buffer_ = nullptr;
 	struct io_uring ring;
-	struct io_uring_params params;
+	bool ring_ready_ = false;
 
   public:
+	explicit IOUring(RingMode mode) : mode_(mode) {}
+
 	bool init(const Config &config) override {
 		config_ = config;
-		buffer_ = new char[config_.block_size * config_.num_operations];
-		memset(&params, 0, sizeof(params));
-		params.flags |= IORING_SETUP_SQPOLL;
-		params.sq_thread_idle = 1000;
-		if (io_uring_queue_init_params(config.num_operations, &ring, &params) !=
-			0) {
-			perror("io_uring_queue_init_params");
+		size_t depth = Utils::iodepth(config_);
+		if (posix_memalign((void **)&buffer_, 4096,
+						   config_.block_size * depth) != 0) {
+			perror("posix_memalign");
 			return false;
 		}
-		return true;
-	}
+		memset(buffer_, 'E', config_.block_size * depth);
+		// The SQPOLL thread may post completions before it publishes how far
+		// it has consumed the submission queue, so room for `depth` entries
+		// besides those in flight keeps refills from finding the queue full.
+		if (!setup_ring(ring, 2 * depth, mode_, config_, name())) {
+			return false;
+		}
+		ring_ready_ = true;
 
-	bool run_read() override {
-		fd_ = open(config_.filename.c_str(), O_RDONLY);
+		// Polled completions only exist for direct I/O.
+		int flags = ring_mode_iopoll(mode_) ? O_RDWR | O_DIRECT : O_RDWR;
+		fd_ = open(config_.filename.c_str(), flags);
 		if (fd_ < 0) {
-			perror("open iouring read");
+			perror("open iouring");
 			return false;
 		}
 
@@ -374,145 +832,1263 @@ class IOUring : public IOMethod {
 			perror("io_uring_register_files");
 			return false;
 		}
+		return true;
+	}
 
-		for (size_t i = 0; i < config_.num_operations; ++i) {
+	// Keep `iodepth` I/Os in flight until the stream runs out, like
+	// `LinuxAIO::run`. The slot of an I/O travels in its user_data.
+	bool run(Stream &stream) override {
+		size_t depth = Utils::iodepth(config_);
+		std::vector<uint64_t> due(depth);
+		std::vector<size_t> reaped;
+		reaped.reserve(depth);
+		size_t inflight = 0;
+
+		// Prepare the next I/O in `slot`, if there is one.
+		auto prep = [&](size_t slot) {
+			const IO *io =
+				stream.next(due[slot], [&]() { io_uring_submit(&ring); });
+			if (!io) {
+				return true;
+			}
 			io_uring_sqe *sqe = io_uring_get_sqe(&ring);
 			if (!sqe) {
-				perror("io_uring_get_sqe");
+				fprintf(stderr, "io_uring_get_sqe: submission queue full\n");
 				return false;
 			}
-			off_t offset = (i * config_.block_size) %
-						   (config_.file_size - config_.block_size);
-			io_uring_prep_read(sqe, fd_, buffer_ + i * config_.block_size,
-							   config_.block_size, offset);
-		}
-		io_uring_submit(&ring);
+			char *buf = buffer_ + slot * config_.block_size;
+			if (io->write) {
+				io_uring_prep_write(sqe, fd_, buf, config_.block_size,
+									io->offset);
+			} else {
+				io_uring_prep_read(sqe, fd_, buf, config_.block_size,
+								   io->offset);
+			}
+			io_uring_sqe_set_data64(sqe, slot);
+			++inflight;
+			return true;
+		};
 
-		struct io_uring_cqe *cqe[config_.num_operations];
-		for (size_t i = 0; i < config_.num_operations; ++i) {
-			if (io_uring_wait_cqe(&ring, &cqe[i]) < 0) {
-				perror("io_uring_wait_cqe");
+		for (size_t slot = 0; slot < depth; ++slot) {
+			if (!prep(slot)) {
 				return false;
 			}
-			if (cqe[i]->res < 0) {
-				fprintf(stderr, "Read error: %s\n", strerror(-cqe[i]->res));
+		}
+		while (inflight > 0) {
+			int ret = io_uring_submit_and_wait(&ring, 1);
+			if (ret < 0) {
+				fprintf(stderr, "io_uring_submit_and_wait: %s\n",
+						strerror(-ret));
 				return false;
 			}
-			// io_uring_cqe_seen(&ring, cqe[i]);
+			// Refilling may wait for the schedule, so what has completed is
+			// reaped and timed before any slot is refilled.
+			uint64_t now = Utils::now_ns();
+			io_uring_cqe *cqe;
+			reaped.clear();
+			while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+				if (cqe->res < 0) {
+					fprintf(stderr, "%s: %s\n", name().c_str(),
+							strerror(-cqe->res));
+					return false;
+				}
+				size_t slot = io_uring_cqe_get_data64(cqe);
+				io_uring_cqe_seen(&ring, cqe);
+				stream.complete(due[slot], now);
+				--inflight;
+				reaped.push_back(slot);
+			}
+			for (size_t slot : reaped) {
+				if (!prep(slot)) {
+					return false;
+				}
+			}
 		}
-
 		return true;
 	}
 
-	bool run_write() override {
-		fd_ = open(config_.filename.c_str(), O_WRONLY);
+	void cleanup() override {
+		if (fd_ >= 0) {
+			close(fd_);
+			fd_ = -1;
+		}
+		free(buffer_);
+		buffer_ = nullptr;
+		if (ring_ready_) {
+			io_uring_queue_exit(&ring);
+			ring_ready_ = false;
+		}
+	}
+
+	std::string name() const override {
+		return std::string("Linux IOUring (") + ring_mode_name(mode_) + ")";
+	}
+	bool async() const override { return true; }
+	size_t buffer_bytes(const Config &config) const override {
+		return Utils::iodepth(config) * config.block_size;
+	}
+};
+
+// io_uring on registered buffers and a registered O_DIRECT file: the
+// kernel pins and maps the buffers once at registration instead of on every
+// I/O, and looks the file up by index instead of taking a reference to it
+// per request. Completions are reaped in batches.
+class IOUringFixed : public IOMethod {
+  private:
+	Config config_;
+	RingMode mode_;
+	int fd_ = -1;
+	char *buffer_ = nullptr;
+	struct io_uring ring;
+	bool ring_ready_ = false;
+
+  public:
+	explicit IOUringFixed(RingMode mode) : mode_(mode) {}
+
+	bool init(const Config &config) override {
+		config_ = config;
+		size_t depth = Utils::iodepth(config_);
+		if (posix_memalign((void **)&buffer_, 4096,
+						   config_.block_size * depth) != 0) {
+			perror("posix_memalign");
+			return false;
+		}
+		memset(buffer_, 'F', config_.block_size * depth);
+		// Twice the depth, as in `IOUring::init`.
+		if (!setup_ring(ring, 2 * depth, mode_, config_, name())) {
+			return false;
+		}
+		ring_ready_ = true;
+
+		fd_ = open(config_.filename.c_str(), O_RDWR | O_DIRECT);
 		if (fd_ < 0) {
-			perror("open iouring write");
+			perror("open iouring fixed");
+			return false;
+		}
+		int ret = io_uring_register_files(&ring, &fd_, 1);
+		if (ret < 0) {
+			fprintf(stderr, "io_uring_register_files: %s\n", strerror(-ret));
 			return false;
 		}
 
-		memset(buffer_, 'E', config_.block_size * config_.num_operations);
+		// One registered buffer per slot, so that a slot's buffer index is
+		// the slot itself.
+		std::vector<iovec> iovecs(depth);
+		for (size_t slot = 0; slot < depth; ++slot) {
+			iovecs[slot].iov_base = buffer_ + slot * config_.block_size;
+			iovecs[slot].iov_len = config_.block_size;
+		}
+		ret = io_uring_register_buffers(&ring, iovecs.data(), depth);
+		if (ret < 0) {
+			fprintf(stderr, "io_uring_register_buffers: %s\n", strerror(-ret));
+			return false;
+		}
+		return true;
+	}
 
-		for (size_t i = 0; i < config_.num_operations; ++i) {
+	// As `IOUring::run`, but on fixed file 0 and fixed buffer `slot`.
+	bool run(Stream &stream) override {
+		size_t depth = Utils::iodepth(config_);
+		std::vector<uint64_t> due(depth);
+		std::vector<io_uring_cqe *> cqes(depth);
+		size_t inflight = 0;
+
+		auto prep = [&](size_t slot) {
+			const IO *io =
+				stream.next(due[slot], [&]() { io_uring_submit(&ring); });
+			if (!io) {
+				return true;
+			}
 			io_uring_sqe *sqe = io_uring_get_sqe(&ring);
 			if (!sqe) {
-				perror("io_uring_get_sqe");
+				fprintf(stderr, "io_uring_get_sqe: submission queue full\n");
 				return false;
 			}
-			off_t offset = (i * config_.block_size) %
-						   (config_.file_size - config_.block_size);
-			io_uring_prep_write(sqe, fd_, buffer_ + i * config_.block_size,
-								config_.block_size, offset);
+			char *buf = buffer_ + slot * config_.block_size;
+			if (io->write) {
+				io_uring_prep_write_fixed(sqe, 0, buf, config_.block_size,
+										  io->offset, slot);
+			} else {
+				io_uring_prep_read_fixed(sqe, 0, buf, config_.block_size,
+										 io->offset, slot);
+			}
+			io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+			io_uring_sqe_set_data64(sqe, slot);
+			++inflight;
+			return true;
+		};
+
+		for (size_t slot = 0; slot < depth; ++slot) {
+			if (!prep(slot)) {
+				return false;
+			}
+		}
+		while (inflight > 0) {
+			int ret = io_uring_submit_and_wait(&ring, 1);
+			if (ret < 0) {
+				fprintf(stderr, "io_uring_submit_and_wait: %s\n",
+						strerror(-ret));
+				return false;
+			}
+			unsigned n = io_uring_peek_batch_cqe(&ring, cqes.data(), depth);
+			uint64_t now = Utils::now_ns();
+			for (unsigned i = 0; i < n; ++i) {
+				if (cqes[i]->res < 0) {
+					fprintf(stderr, "%s: %s\n", name().c_str(),
+							strerror(-cqes[i]->res));
+					io_uring_cq_advance(&ring, n);
+					return false;
+				}
+				size_t slot = io_uring_cqe_get_data64(cqes[i]);
+				stream.complete(due[slot], now);
+				--inflight;
+				if (!prep(slot)) {
+					io_uring_cq_advance(&ring, n);
+					return false;
+				}
+			}
+			io_uring_cq_advance(&ring, n);
 		}
-		io_uring_submit(&ring);
+		return true;
+	}
 
-		struct io_uring_cqe *cqe[config_.num_operations];
-		for (size_t i = 0; i < config_.num_operations; ++i) {
-			if (io_uring_wait_cqe(&ring, &cqe[i]) < 0) {
-				perror("io_uring_wait_cqe");
+	void cleanup() override {
+		if (ring_ready_) {
+			io_uring_queue_exit(&ring);
+			ring_ready_ = false;
+		}
+		if (fd_ >= 0) {
+			close(fd_);
+			fd_ = -1;
+		}
+		free(buffer_);
+		buffer_ = nullptr;
+	}
+
+	std::string name() const override {
+		return std::string("IOUring fixed (") + ring_mode_name(mode_) + ")";
+	}
+	bool async() const override { return true; }
+	size_t buffer_bytes(const Config &config) const override {
+		return Utils::iodepth(config) * config.block_size;
+	}
+};
+
+// Reads into provided buffers: rather than each I/O bringing a buffer of its
+// own, reads select one from a ring of `Config::buf_ring` buffers registered
+// with the kernel, and the completion says which. Buffers go back to the
+// ring once consumed, here right away. Each of `Config::files` files is
+// opened on its own, as a separate fixed file, so that each keeps its own
+// readahead state. Writes, which cannot select buffers, share one source
+// buffer. A read that finds the ring empty fails with ENOBUFS and is issued
+// again when a buffer comes back.
+class IOUringBufRing : public IOMethod {
+  private:
+	static constexpr int kGroup = 0;
+
+	Config config_;
+	RingMode mode_;
+	std::vector<int> fds_;
+	unsigned entries_ = 0;
+	char *buffers_ = nullptr;
+	char *source_ = nullptr;
+	struct io_uring ring;
+	bool ring_ready_ = false;
+	io_uring_buf_ring *buf_ring_ = nullptr;
+	size_t retries_ = 0;
+
+	// Ring entries: `Config::buf_ring` or the queue depth, rounded up to a
+	// power of two as the kernel requires.
+	static unsigned entries(const Config &config) {
+		size_t wanted =
+			config.buf_ring ? config.buf_ring : Utils::iodepth(config);
+		unsigned entries = 1;
+		while (entries < wanted && entries < 32768) {
+			entries <<= 1;
+		}
+		return entries;
+	}
+
+	void recycle(unsigned short bid) {
+		io_uring_buf_ring_add(buf_ring_, buffers_ + bid * config_.block_size,
+							  config_.block_size, bid,
+							  io_uring_buf_ring_mask(entries_), 0);
+		io_uring_buf_ring_advance(buf_ring_, 1);
+	}
+
+  public:
+	explicit IOUringBufRing(RingMode mode) : mode_(mode) {}
+
+	bool init(const Config &config) override {
+		config_ = config;
+		size_t depth = Utils::iodepth(config_);
+		entries_ = entries(config_);
+		if (posix_memalign((void **)&buffers_, 4096,
+						   config_.block_size * entries_) != 0 ||
+			posix_memalign((void **)&source_, 4096, config_.block_size) !=
+				0) {
+			perror("posix_memalign");
+			return false;
+		}
+		memset(source_, 'R', config_.block_size);
+		// Twice the depth, as in `IOUring::init`.
+		if (!setup_ring(ring, 2 * depth, mode_, config_, name())) {
+			return false;
+		}
+		ring_ready_ = true;
+
+		int flags = ring_mode_iopoll(mode_) ? O_RDWR | O_DIRECT : O_RDWR;
+		for (size_t file = 0; file < config_.files; ++file) {
+			int fd = open(config_.filename.c_str(), flags);
+			if (fd < 0) {
+				perror("open iouring buf ring");
+				return false;
+			}
+			fds_.push_back(fd);
+		}
+		int ret = io_uring_register_files(&ring, fds_.data(), fds_.size());
+		if (ret < 0) {
+			fprintf(stderr, "io_uring_register_files: %s\n", strerror(-ret));
+			return false;
+		}
+
+		buf_ring_ = io_uring_setup_buf_ring(&ring, entries_, kGroup, 0, &ret);
+		if (!buf_ring_) {
+			fprintf(stderr, "io_uring_setup_buf_ring: %s\n", strerror(-ret));
+			return false;
+		}
+		for (unsigned bid = 0; bid < entries_; ++bid) {
+			io_uring_buf_ring_add(buf_ring_,
+								  buffers_ + bid * config_.block_size,
+								  config_.block_size, bid,
+								  io_uring_buf_ring_mask(entries_), bid);
+		}
+		io_uring_buf_ring_advance(buf_ring_, entries_);
+		return true;
+	}
+
+	// As `IOUring::run`, except that a slot only tracks an I/O in flight,
+	// and a read's buffer comes with its completion.
+	bool run(Stream &stream) override {
+		size_t depth = Utils::iodepth(config_);
+		std::vector<uint64_t> due(depth);
+		std::vector<const IO *> ios(depth);
+		// Slots of reads that found the ring empty, issued again as buffers
+		// come back.
+		std::vector<size_t> waiting;
+		std::vector<size_t> reaped;
+		reaped.reserve(depth);
+		size_t inflight = 0;
+
+		auto issue = [&](size_t slot) {
+			io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+			if (!sqe) {
+				fprintf(stderr, "io_uring_get_sqe: submission queue full\n");
+				return false;
+			}
+			const IO *io = ios[slot];
+			if (io->write) {
+				io_uring_prep_write(sqe, io->file, source_,
+									config_.block_size, io->offset);
+				io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+			} else {
+				io_uring_prep_read(sqe, io->file, nullptr, config_.block_size,
+								   io->offset);
+				io_uring_sqe_set_flags(sqe,
+									   IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT);
+				sqe->buf_group = kGroup;
+			}
+			io_uring_sqe_set_data64(sqe, slot);
+			++inflight;
+			return true;
+		};
+		auto prep = [&](size_t slot) {
+			ios[slot] =
+				stream.next(due[slot], [&]() { io_uring_submit(&ring); });
+			return !ios[slot] || issue(slot);
+		};
+
+		for (size_t slot = 0; slot < depth; ++slot) {
+			if (!prep(slot)) {
+				return false;
+			}
+		}
+		while (inflight > 0) {
+			int ret = io_uring_submit_and_wait(&ring, 1);
+			if (ret < 0) {
+				fprintf(stderr, "io_uring_submit_and_wait: %s\n",
+						strerror(-ret));
+				return false;
+			}
+			// Reaped and timed before any slot is refilled, as in
+			// `IOUring::run`.
+			uint64_t now = Utils::now_ns();
+			io_uring_cqe *cqe;
+			reaped.clear();
+			while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+				int res = cqe->res;
+				unsigned cqe_flags = cqe->flags;
+				size_t slot = io_uring_cqe_get_data64(cqe);
+				io_uring_cqe_seen(&ring, cqe);
+				--inflight;
+				if (res == -ENOBUFS) {
+					++retries_;
+					waiting.push_back(slot);
+					continue;
+				}
+				if (res < 0) {
+					fprintf(stderr, "%s: %s\n", name().c_str(),
+							strerror(-res));
+					return false;
+				}
+				if (cqe_flags & IORING_CQE_F_BUFFER) {
+					recycle(cqe_flags >> IORING_CQE_BUFFER_SHIFT);
+					if (!waiting.empty()) {
+						if (!issue(waiting.back())) {
+							return false;
+						}
+						waiting.pop_back();
+					}
+				}
+				stream.complete(due[slot], now);
+				reaped.push_back(slot);
+			}
+			for (size_t slot : reaped) {
+				if (!prep(slot)) {
+					return false;
+				}
+			}
+			// With nothing in flight, no buffer is coming back.
+			if (inflight == 0 && !waiting.empty()) {
+				fprintf(stderr, "%s: buffer ring empty\n", name().c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void cleanup() override {
+		if (config_.verbose && retries_) {
+			fprintf(stderr, "%s: %zu reads retried on an empty buffer ring\n",
+					name().c_str(), retries_);
+		}
+		retries_ = 0;
+		if (ring_ready_) {
+			if (buf_ring_) {
+				io_uring_free_buf_ring(&ring, buf_ring_, entries_, kGroup);
+				buf_ring_ = nullptr;
+			}
+			io_uring_queue_exit(&ring);
+			ring_ready_ = false;
+		}
+		for (int fd : fds_) {
+			close(fd);
+		}
+		fds_.clear();
+		free(buffers_);
+		buffers_ = nullptr;
+		free(source_);
+		source_ = nullptr;
+	}
+
+	std::string name() const override {
+		return std::string("IOUring buf ring (") + ring_mode_name(mode_) +
+			   ")";
+	}
+	bool async() const override { return true; }
+	size_t buffer_bytes(const Config &config) const override {
+		return (entries(config) + 1) * config.block_size +
+			   entries(config) * sizeof(io_uring_buf);
+	}
+};
+
+// Durable writes, as on a commit log: every `Config::sync_every` writes form
+// a commit, made durable as `SyncMode` says before the next one starts. The
+// latency histogram holds one value per commit, from its first write until
+// it is durable; reads are plain preads, timed one by one.
+class SyncIO : public IOMethod {
+  public:
+	// Most writes per commit with UringLink, whose ring holds a commit's
+	// writes and its fdatasync within io_uring's 32768 entries.
+	static constexpr size_t kMaxLinked = 32767;
+
+  private:
+	Config config_;
+	SyncMode mode_;
+	int fd_ = -1;
+	char *buffer_ = nullptr;
+	struct io_uring ring;
+	bool ring_ready_ = false;
+
+	// Make the `pending` writes since the last commit, to bytes [lo, hi),
+	// durable. For UringLink they are queued on the ring, linked one to the
+	// next, and the fdatasync is linked to the last.
+	bool commit(size_t pending, off_t lo, off_t hi) {
+		switch (mode_) {
+		case SyncMode::Fsync:
+			if (fsync(fd_) != 0) {
+				perror("fsync");
+				return false;
+			}
+			return true;
+		case SyncMode::Fdatasync:
+			if (fdatasync(fd_) != 0) {
+				perror("fdatasync");
+				return false;
+			}
+			return true;
+		case SyncMode::Dsync:
+			return true;
+		case SyncMode::SyncFileRange:
+			if (sync_file_range(fd_, lo, hi - lo,
+								SYNC_FILE_RANGE_WAIT_BEFORE |
+									SYNC_FILE_RANGE_WRITE |
+									SYNC_FILE_RANGE_WAIT_AFTER) != 0) {
+				perror("sync_file_range");
+				return false;
+			}
+			return true;
+		case SyncMode::UringLink:
+			break;
+		}
+
+		// The ring has room for a commit's writes and its fdatasync.
+		io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+		if (!sqe) {
+			fprintf(stderr, "io_uring_get_sqe: submission queue full\n");
+			return false;
+		}
+		io_uring_prep_fsync(sqe, fd_, IORING_FSYNC_DATASYNC);
+		int ret = io_uring_submit_and_wait(&ring, pending + 1);
+		if (ret < 0) {
+			fprintf(stderr, "io_uring_submit_and_wait: %s\n", strerror(-ret));
+			return false;
+		}
+		bool ok = true;
+		for (size_t i = 0; i <= pending; ++i) {
+			io_uring_cqe *cqe;
+			ret = io_uring_wait_cqe(&ring, &cqe);
+			if (ret < 0) {
+				fprintf(stderr, "io_uring_wait_cqe: %s\n", strerror(-ret));
 				return false;
 			}
-			if (cqe[i]->res < 0) {
-				fprintf(stderr, "Write error: %s\n", strerror(-cqe[i]->res));
+			if (cqe->res < 0 && ok) {
+				fprintf(stderr, "%s: %s\n", name().c_str(),
+						strerror(-cqe->res));
+				ok = false;
+			}
+			io_uring_cqe_seen(&ring, cqe);
+		}
+		return ok;
+	}
+
+  public:
+	explicit SyncIO(SyncMode mode) : mode_(mode) {}
+
+	bool init(const Config &config) override {
+		config_ = config;
+		config_.sync_every = std::max<size_t>(1, config_.sync_every);
+		if (posix_memalign((void **)&buffer_, 4096, config_.block_size) != 0) {
+			perror("posix_memalign");
+			return false;
+		}
+		memset(buffer_, 'S', config_.block_size);
+		int flags = O_RDWR | (mode_ == SyncMode::Dsync ? O_DSYNC : 0);
+		fd_ = open(config_.filename.c_str(), flags);
+		if (fd_ < 0) {
+			perror("open sync");
+			return false;
+		}
+		if (mode_ == SyncMode::UringLink) {
+			int ret = io_uring_queue_init(config_.sync_every + 1, &ring, 0);
+			if (ret < 0) {
+				fprintf(stderr, "io_uring_queue_init: %s\n", strerror(-ret));
 				return false;
 			}
-			// io_uring_cqe_seen(&ring, cqe[i]);
+			ring_ready_ = true;
 		}
+		return true;
+	}
+
+	// A commit's writes stay queued on the ring until it commits, even when
+	// the stream waits for the next one: submitting part of a linked chain
+	// would end the chain there.
+	bool run(Stream &stream) override {
+		size_t pending = 0;
+		uint64_t start = 0, due;
+		off_t lo = 0, hi = 0;
+		while (const IO *io = stream.next(due)) {
+			if (!io->write) {
+				if (pread(fd_, buffer_, config_.block_size, io->offset) !=
+					(ssize_t)config_.block_size) {
+					perror("pread");
+					return false;
+				}
+				stream.complete(due, Utils::now_ns());
+				continue;
+			}
 
+			if (pending == 0) {
+				start = due;
+				lo = io->offset;
+				hi = io->offset;
+			}
+			lo = std::min(lo, io->offset);
+			hi = std::max(hi, io->offset + (off_t)config_.block_size);
+			if (mode_ == SyncMode::UringLink) {
+				io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+				if (!sqe) {
+					fprintf(stderr, "io_uring_get_sqe: submission queue full\n");
+					return false;
+				}
+				io_uring_prep_write(sqe, fd_, buffer_, config_.block_size,
+									io->offset);
+				io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+			} else if (pwrite(fd_, buffer_, config_.block_size, io->offset) !=
+					   (ssize_t)config_.block_size) {
+				perror("pwrite");
+				return false;
+			}
+			if (++pending == config_.sync_every) {
+				if (!commit(pending, lo, hi)) {
+					return false;
+				}
+				stream.complete(start, Utils::now_ns(), pending);
+				pending = 0;
+			}
+		}
+		if (pending > 0) {
+			if (!commit(pending, lo, hi)) {
+				return false;
+			}
+			stream.complete(start, Utils::now_ns(), pending);
+		}
 		return true;
 	}
 
 	void cleanup() override {
+		if (ring_ready_) {
+			io_uring_queue_exit(&ring);
+			ring_ready_ = false;
+		}
 		if (fd_ >= 0) {
 			close(fd_);
 			fd_ = -1;
 		}
-		delete[] buffer_;
+		free(buffer_);
 		buffer_ = nullptr;
-		io_uring_queue_exit(&ring);
 	}
 
-	std::string name() const override { return "Linux IOUring"; }
+	std::string name() const override {
+		return std::string("Sync (") + sync_mode_name(mode_) + ")";
+	}
 };
 
 // Benchmark runner
 class BenchmarkRunner {
-  public:
-	static void run(const Config &config) {
-		std::vector<std::unique_ptr<IOMethod>> methods;
-		methods.emplace_back(std::make_unique<BufferedIO>());
-		methods.emplace_back(std::make_unique<DirectIO>());
-		methods.emplace_back(std::make_unique<LinuxAIO>());
-		methods.emplace_back(std::make_unique<IOUring>());
+  private:
+	using Factory = std::function<std::unique_ptr<IOMethod>()>;
+
+	// A named phase every engine runs in turn, with one stream of I/Os per
+	// worker.
+	struct Phase {
+		std::string name;
+		std::vector<std::vector<IO>> ios;
+	};
+
+	// Outcome of one phase across all workers.
+	struct Result {
+		bool ok = true;
+		uint64_t ops = 0;		// I/Os completed after the ramp.
+		double ms = 0;			// From the end of the ramp to the last of them.
+		uint64_t completed = 0; // I/Os completed, ramp included.
+		double wall = 0;		// The whole phase, in ms.
+		double cpu = 0;			// Process CPU time meanwhile, in ms.
+		Histogram latency;
+	};
+
+	static std::vector<Factory> engines(const Config &config) {
+		std::vector<Factory> engines;
+		engines.push_back([]() { return std::make_unique<BufferedIO>(); });
+		engines.push_back([]() { return std::make_unique<DirectIO>(); });
+		engines.push_back([]() { return std::make_unique<MmapIO>(); });
+		engines.push_back([]() { return std::make_unique<VectoredIO>(); });
+		engines.push_back([]() { return std::make_unique<LinuxAIO>(); });
+		for (RingMode mode : config.ring_modes) {
+			engines.push_back(
+				[mode]() { return std::make_unique<IOUring>(mode); });
+		}
+		for (RingMode mode : config.ring_modes) {
+			engines.push_back(
+				[mode]() { return std::make_unique<IOUringFixed>(mode); });
+		}
+		for (RingMode mode : config.ring_modes) {
+			engines.push_back(
+				[mode]() { return std::make_unique<IOUringBufRing>(mode); });
+		}
+		for (SyncMode mode : config.sync_modes) {
+			engines.push_back([mode]() { return std::make_unique<SyncIO>(mode); });
+		}
+		return engines;
+	}
 
-		std::cout << "Linux IO Benchmark Results\n";
-		std::cout << "=========================\n";
-		std::cout << "File size: " << config.file_size / (1024 * 1024)
-				  << " MB\n";
-		std::cout << "Block size: " << config.block_size << " bytes\n";
-		std::cout << "Operations: " << config.num_operations << "\n\n";
+	// Reads and writes run on the same offsets, the mixed phase on the same
+	// offsets again with reads and writes interleaved. Worker `i` gets the
+	// `i`-th of `jobs` equal slices of the file and a seed of its own.
+	static std::vector<Phase> phases(const Config &config, size_t jobs) {
+		size_t slice = config.file_size / jobs / config.block_size *
+					   config.block_size;
+		auto workload = [&](unsigned read_percent) {
+			std::vector<std::vector<IO>> ios(jobs);
+			for (size_t job = 0; job < jobs; ++job) {
+				ios[job] = make_workload(config.pattern, slice,
+										 config.block_size, config.files,
+										 config.num_operations, read_percent,
+										 config.seed + job, config.zipf_theta);
+				for (IO &io : ios[job]) {
+					io.offset += job * slice;
+				}
+			}
+			return ios;
+		};
+		std::vector<Phase> phases;
+		phases.push_back({"Read", workload(100)});
+		phases.push_back({"Write", workload(0)});
+		if (config.rwmix >= 0) {
+			phases.push_back({"Mixed", workload(config.rwmix)});
+		}
+		return phases;
+	}
 
-		if (!Utils::create_test_file(config.filename, config.file_size)) {
-			std::cerr << "Failed to create test file\n";
+	static void pin(size_t job) {
+		cpu_set_t allowed;
+		if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
 			return;
 		}
+		size_t target = job % CPU_COUNT(&allowed);
+		for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+			if (CPU_ISSET(cpu, &allowed) && target-- == 0) {
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				CPU_SET(cpu, &set);
+				pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+				return;
+			}
+		}
+	}
+
+	// Run every phase on `config.jobs` workers, each with its own instance
+	// of the engine. A worker initializes, runs and cleans up its instance
+	// on its own thread, which io_uring's SINGLE_ISSUER and DEFER_TASKRUN
+	// require; workers start each phase together. With `report`, time-based
+	// phases print their progress every `config.interval` seconds. Returns
+	// no results if any worker fails to initialize.
+	static std::vector<Result> run_jobs(const Factory &factory,
+										const Config &config,
+										const std::vector<Phase> &phases,
+										bool report) {
+		size_t jobs = config.jobs;
+		std::vector<std::unique_ptr<IOMethod>> methods;
+		for (size_t job = 0; job < jobs; ++job) {
+			methods.push_back(factory());
+		}
+		std::vector<char> ready(jobs, false);
+		std::vector<char> ok(jobs, true);
+		std::vector<Histogram> latency(jobs);
+		std::vector<std::atomic<Stream *>> streams(jobs);
+		std::atomic<size_t> done{0};
+		std::barrier sync(jobs + 1);
+
+		Stream::Options options;
+		options.runtime_ns = config.runtime * 1e9;
+		options.ramp_ns = config.ramp * 1e9;
+		options.rate = config.rate / jobs;
+
+		auto all_ready = [&]() {
+			return std::all_of(ready.begin(), ready.end(),
+							   [](char r) { return r; });
+		};
+
+		std::vector<std::thread> workers;
+		for (size_t job = 0; job < jobs; ++job) {
+			workers.emplace_back([&, job]() {
+				if (config.pin) {
+					pin(job);
+				}
+				IOMethod &method = *methods[job];
+				ready[job] = method.init(config);
+				sync.arrive_and_wait();
+				if (all_ready()) {
+					for (const Phase &phase : phases) {
+						latency[job].reset();
+						sync.arrive_and_wait();
+						Stream stream(phase.ios[job], options, latency[job]);
+						streams[job] = &stream;
+						ok[job] = method.run(stream);
+						++done;
+						sync.arrive_and_wait();
+						sync.arrive_and_wait(); // Results collected.
+						streams[job] = nullptr;
+					}
+				}
+				method.cleanup();
+			});
+		}
+
+		std::vector<Result> results;
+		sync.arrive_and_wait();
+		if (all_ready()) {
+			for (const Phase &phase : phases) {
+				done = 0;
+				double cpu = Utils::cpu_ms();
+				uint64_t start = Utils::now_ns();
+				sync.arrive_and_wait();
+				if (report && config.runtime > 0 && config.interval > 0) {
+					report_intervals(config, phase, streams, done, start);
+				}
+				sync.arrive_and_wait();
+				uint64_t end = Utils::now_ns();
+
+				Result result;
+				result.wall = (end - start) / 1e6;
+				result.cpu = Utils::cpu_ms() - cpu;
+				uint64_t from = end, last = start;
+				for (size_t job = 0; job < jobs; ++job) {
+					const Stream &stream = *streams[job];
+					result.ok = result.ok && ok[job];
+					result.ops += stream.measured();
+					result.completed += stream.completed();
+					if (stream.measured() > 0) {
+						from = std::min(from, stream.measure_from());
+						last = std::max(last, stream.last());
+					}
+					result.latency.merge(latency[job]);
+				}
+				result.ms = result.ops > 0 ? (last - from) / 1e6 : result.wall;
+				results.push_back(std::move(result));
+				sync.arrive_and_wait();
+			}
+		}
+		for (std::thread &worker : workers) {
+			worker.join();
+		}
+		return results;
+	}
 
-		for (auto &method : methods) {
-			if (!method->init(config)) {
-				std::cerr << "Failed to initialize " << method->name() << "\n";
+	// Print the IOPS, throughput and mean latency of every interval of
+	// `phase` until all workers are done, then of what is left of the last
+	// unless that is only a sliver.
+	static void report_intervals(const Config &config, const Phase &phase,
+								 const std::vector<std::atomic<Stream *>> &streams,
+								 const std::atomic<size_t> &done,
+								 uint64_t start) {
+		uint64_t interval = config.interval * 1e9;
+		uint64_t prev = start, next = start + interval;
+		uint64_t completed = 0, latency = 0;
+		for (bool last = false; !last;) {
+			last = done == streams.size();
+			uint64_t now = Utils::now_ns();
+			if (!last && now < next) {
+				std::this_thread::sleep_for(std::chrono::nanoseconds(
+					std::min<uint64_t>(next - now, 10000000)));
 				continue;
 			}
+			uint64_t total = 0, sum = 0;
+			for (const auto &stream : streams) {
+				if (Stream *s = stream.load()) {
+					total += s->completed();
+					sum += s->latency_sum();
+				}
+			}
+			uint64_t ios = total - completed;
+			double seconds = ((last ? now : next) - prev) / 1e9;
+			if (!last || (ios > 0 && seconds >= config.interval / 10)) {
+				printf("  [%6.1fs] %-5s %10.0f IOPS %9.1f MB/s   avg %.1f us%s\n",
+					   ((last ? now : next) - start) / 1e9,
+					   phase.name.c_str(), ios / seconds,
+					   ios * config.block_size / seconds / 1e6,
+					   ios ? (sum - latency) / 1e3 / ios : 0.0,
+					   next - start <= config.ramp * 1e9 ? " (ramp)" : "");
+				fflush(stdout);
+			}
+			completed = total;
+			latency = sum;
+			prev = next;
+			next += interval;
+		}
+	}
 
-			std::cout << method->name() << ":\n";
+	// Set the page-cache state for the next engine, returning the fraction
+	// of the file then resident.
+	static double prepare_cache(const Config &config) {
+		Utils::set_cache_state(config.filename, config.file_size,
+							   config.cache);
+		return Utils::resident(config.filename, config.file_size);
+	}
+
+	// I/Os per second across all workers.
+	static double iops(const Result &result) {
+		return result.ops / (result.ms / 1000.0);
+	}
 
-			double read_time =
-				Utils::benchmark([&]() { return method->run_read(); });
-			if (read_time > 0) {
-				double read_throughput =
-					(config.num_operations * config.block_size) /
-					(read_time * 1000.0);
-				std::cout << "  Read:  " << read_time << " ms ("
-						  << read_throughput << " MB/s)\n";
+	// CPU time per completed I/O in microseconds, or NaN with none.
+	static double cpu_per_io(const Result &result) {
+		return result.completed ? result.cpu * 1e3 / result.completed : NAN;
+	}
+
+	static void print_latency(const Histogram &latency) {
+		if (latency.count() == 0) {
+			printf("         lat us: none measured\n");
+			return;
+		}
+		printf("         lat us: avg %.1f, p50 %.1f, p90 %.1f, p99 %.1f, "
+			   "p99.9 %.1f, max %.1f\n",
+			   latency.mean() / 1e3, latency.percentile(50) / 1e3,
+			   latency.percentile(90) / 1e3, latency.percentile(99) / 1e3,
+			   latency.percentile(99.9) / 1e3, latency.max() / 1e3);
+	}
+
+	// The record of a phase of engine `name`, run with `config`.
+	static Record record(const IOMethod &method, const Config &config,
+						 const Phase &phase, const Result &result,
+						 double cached) {
+		Record record;
+		record.engine = method.name();
+		record.buffer_kb = method.buffer_bytes(config) / 1024.0;
+		record.jobs = config.jobs;
+		record.iodepth = Utils::iodepth(config);
+		record.phase = phase.name;
+		record.ok = result.ok;
+		record.cached = cached;
+		if (!result.ok) {
+			return record;
+		}
+		record.ops = result.ops;
+		record.ms = result.ms;
+		record.iops = iops(result);
+		record.mb_per_s =
+			result.ops * config.block_size / (result.ms * 1000.0);
+		if (result.latency.count() > 0) {
+			record.lat_avg = result.latency.mean() / 1e3;
+			record.lat_p50 = result.latency.percentile(50) / 1e3;
+			record.lat_p90 = result.latency.percentile(90) / 1e3;
+			record.lat_p99 = result.latency.percentile(99) / 1e3;
+			record.lat_p999 = result.latency.percentile(99.9) / 1e3;
+			record.lat_max = result.latency.max() / 1e3;
+		}
+		record.cpu_ms = result.cpu;
+		record.cpu_us_per_io = cpu_per_io(result);
+		return record;
+	}
+
+	static void run_once(const Config &config,
+						 const std::vector<Phase> &phases,
+						 std::vector<Record> &records) {
+		for (const Factory &factory : engines(config)) {
+			std::unique_ptr<IOMethod> probe = factory();
+			std::string name = probe->name();
+			double cached = prepare_cache(config);
+			std::cout << name << ":" << std::endl;
+			if (cached >= 0) {
+				printf("  Cached: %.1f%% of the file before the run\n",
+					   cached * 100);
+			}
+			printf("  Buffers: %.1f KB per worker\n",
+				   probe->buffer_bytes(config) / 1024.0);
+			std::vector<Result> results =
+				run_jobs(factory, config, phases, true);
+			if (results.empty()) {
+				std::cerr << "Failed to initialize " << name << "\n\n";
+				continue;
 			}
 
-			double write_time =
-				Utils::benchmark([&]() { return method->run_write(); });
-			if (write_time > 0) {
-				double write_throughput =
-					(config.num_operations * config.block_size) /
-					(write_time * 1000.0);
-				std::cout << "  Write: " << write_time << " ms ("
-						  << write_throughput << " MB/s)\n";
+			for (size_t i = 0; i < phases.size(); ++i) {
+				const Result &result = results[i];
+				records.push_back(
+					record(*probe, config, phases[i], result, cached));
+				if (!result.ok) {
+					continue;
+				}
+				double throughput =
+					(result.ops * config.block_size) / (result.ms * 1000.0);
+				std::cout << "  " << phases[i].name << ":"
+						  << std::string(6 - phases[i].name.size(), ' ')
+						  << result.ms << " ms (" << throughput << " MB/s, "
+						  << iops(result) << " IOPS)\n";
+				print_latency(result.latency);
+				printf("         cpu: %.1f ms (%.0f%% of wall time)",
+					   result.cpu, result.cpu / result.wall * 100);
+				if (result.completed) {
+					printf(", %.2f us per I/O", cpu_per_io(result));
+				}
+				printf("\n");
 			}
 
-			method->cleanup();
 			std::cout << std::endl;
 		}
+	}
+
+	// One row per engine, worker count and queue depth, each on freshly
+	// initialized engines, with the IOPS, mean and p99 latency, and CPU time
+	// per I/O of every phase. Synchronous engines only have rows at depth 1.
+	static void run_sweep(const Config &config, std::vector<Record> &records) {
+		std::vector<size_t> depths = config.sweep;
+		if (depths.empty()) {
+			depths.push_back(config.iodepth);
+		}
+		std::vector<size_t> job_counts = config.jobs_sweep;
+		if (job_counts.empty()) {
+			job_counts.push_back(config.jobs);
+		}
+
+		bool header = false;
+		for (const Factory &factory : engines(config)) {
+			std::unique_ptr<IOMethod> probe = factory();
+			for (size_t jobs : job_counts) {
+				std::vector<Phase> phases = BenchmarkRunner::phases(config, jobs);
+				if (!header) {
+					printf("%-30s %4s %5s %7s %8s", "Engine", "Jobs", "QD",
+						   "Cached", "Buf KB");
+					for (const Phase &phase : phases) {
+						printf(" %12s %10s %10s %10s",
+							   (phase.name + " IOPS").c_str(), "avg us",
+							   "p99 us", "cpu us/io");
+					}
+					printf("\n");
+					header = true;
+				}
+				for (size_t depth : depths) {
+					if (!probe->async() && depth != 1) {
+						continue;
+					}
+					Config run = config;
+					run.iodepth = depth;
+					run.jobs = jobs;
+					double cached = prepare_cache(run);
+					std::vector<Result> results =
+						run_jobs(factory, run, phases, false);
+					if (results.empty()) {
+						std::cerr << "Failed to initialize " << probe->name()
+								  << " with " << jobs << " jobs at depth "
+								  << depth << "\n";
+						continue;
+					}
+					printf("%-30s %4zu %5zu", probe->name().c_str(), jobs,
+						   Utils::iodepth(run));
+					// Residency is unknown when prepare_cache returns -1.
+					if (cached >= 0) {
+						printf(" %6.1f%%", cached * 100);
+					} else {
+						printf(" %7s", "-");
+					}
+					printf(" %8.0f", probe->buffer_bytes(run) / 1024.0);
+					for (size_t i = 0; i < phases.size(); ++i) {
+						const Result &result = results[i];
+						records.push_back(
+							record(*probe, run, phases[i], result, cached));
+						if (!result.ok) {
+							printf(" %12s %10s %10s %10s", "failed", "-", "-",
+								   "-");
+							continue;
+						}
+						if (!result.completed) {
+							printf(" %12.0f %10s %10s %10s", 0.0, "-", "-",
+								   "-");
+							continue;
+						}
+						printf(" %12.0f %10.1f %10.1f %10.2f",
+							   iops(result),
+							   result.latency.mean() / 1e3,
+							   result.latency.percentile(99) / 1e3,
+							   cpu_per_io(result));
+					}
+					printf("\n");
+				}
+			}
+		}
+	}
+
+  public:
+	// The configuration as written with JSON and CSV results.
+	static std::vector<Setting> settings(const Config &config) {
+		utsname system;
+		std::string kernel = uname(&system) == 0 ? system.release : "";
+		auto number = [](double value) {
+			std::ostringstream out;
+			out << value;
+			return out.str();
+		};
+		return {
+			{"kernel", kernel, true},
+			{"file_size", std::to_string(config.file_size), false},
+			{"block_size", std::to_string(config.block_size), false},
+			{"ops", std::to_string(config.num_operations), false},
+			{"pattern", pattern_name(config.pattern), true},
+			{"files", std::to_string(config.files), false},
+			{"buf_ring", std::to_string(config.buf_ring), false},
+			{"seed", std::to_string(config.seed), false},
+			{"rwmix", std::to_string(config.rwmix), false},
+			{"runtime", number(config.runtime), false},
+			{"ramp", number(config.ramp), false},
+			{"rate", number(config.rate), false},
+			{"pin", config.pin ? "true" : "false", false},
+			{"cache", cache_mode_name(config.cache), true},
+			{"sync_every", std::to_string(config.sync_every), false},
+			{"uring_flags", ring_flag_names(config.ring_flags), true},
+		};
+	}
+
+	// Run the benchmark. Returns false if it could not run or, with a
+	// baseline to compare against, if it regressed.
+	static bool run(const Config &config) {
+		std::vector<Record> baseline;
+		if (!config.compare.empty()) {
+			JsonValue baseline_config;
+			if (!read_json_report(config.compare, baseline,
+								  &baseline_config)) {
+				std::cerr << "Failed to read baseline " << config.compare
+						  << "\n";
+				return false;
+			}
+			// Results of another configuration are not comparable.
+			std::vector<std::string> changes =
+				config_changes(baseline_config, settings(config));
+			if (!changes.empty()) {
+				std::cerr << "Baseline " << config.compare
+						  << " was run with other settings:\n";
+				for (const std::string &change : changes) {
+					std::cerr << "  " << change << "\n";
+				}
+				return false;
+			}
+		}
+
+		// With machine-readable output, stdout is kept for it and the text
+		// goes to stderr.
+		FILE *output = nullptr;
+		if (config.output != Output::Text) {
+			fflush(stdout);
+			int fd = dup(STDOUT_FILENO);
+			if (fd < 0 || !(output = fdopen(fd, "w")) ||
+				dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+				perror("Redirecting output");
+				return false;
+			}
+		}
+
+		std::cout << "Linux IO Benchmark Results\n";
+		std::cout << "=========================\n";
+		std::cout << "File size: " << config.file_size / (1024 * 1024)
+				  << " MB\n";
+		std::cout << "Block size: " << config.block_size << " bytes\n";
+		std::cout << "Operations: " << config.num_operations
+				  << (config.jobs > 1 || !config.jobs_sweep.empty()
+						  ? " per job\n"
+						  : "\n");
+		std::cout << "Pattern: " << pattern_name(config.pattern)
+				  << " (seed " << config.seed << ")\n";
+		if (config.files > 1) {
+			std::cout << "Files: " << config.files << " per job\n";
+		}
+		if (config.rwmix >= 0) {
+			std::cout << "Mixed reads: " << config.rwmix << "%\n";
+		}
+		if (config.sweep.empty()) {
+			std::cout << "IO depth: " << config.iodepth << "\n";
+		}
+		if (config.jobs_sweep.empty()) {
+			std::cout << "Jobs: " << config.jobs
+					  << (config.pin ? " (pinned)\n" : "\n");
+		}
+		if (config.runtime > 0) {
+			std::cout << "Runtime: " << config.runtime << " s per phase";
+			if (config.ramp > 0) {
+				std::cout << ", first " << config.ramp << " s left out";
+			}
+			std::cout << "\n";
+		}
+		if (config.rate > 0) {
+			std::cout << "Rate: " << config.rate
+					  << " IOPS (latency from when each I/O was due)\n";
+		}
+		std::cout << "Page cache: " << cache_mode_name(config.cache)
+				  << " before each engine\n";
+		if (!config.sync_modes.empty()) {
+			std::cout << "Writes per commit: " << config.sync_every
+					  << " (Sync latencies are per commit)\n";
+		}
+		if (config.ring_flags) {
+			std::cout << "io_uring flags: "
+					  << ring_flag_names(config.ring_flags) << "\n";
+		}
+		std::cout << "\n";
+
+		if (config.reuse &&
+			Utils::valid_test_file(config.filename, config.file_size)) {
+			std::cout << "Reusing test file " << config.filename << "\n\n";
+		} else {
+			double time = Utils::benchmark([&]() {
+				return Utils::create_test_file(config.filename,
+											   config.file_size);
+			});
+			if (time < 0) {
+				std::cerr << "Failed to create test file\n";
+				return false;
+			}
+			std::cout << "Created test file in " << time << " ms ("
+					  << config.file_size / (time * 1000.0) << " MB/s)\n\n";
+		}
 
-		Utils::remove_file(config.filename);
+		std::vector<Record> records;
+		if (config.sweep.empty() && config.jobs_sweep.empty()) {
+			run_once(config, phases(config, config.jobs), records);
+		} else {
+			run_sweep(config, records);
+		}
+
+		if (!config.reuse) {
+			Utils::remove_file(config.filename);
+		}
+
+		if (output) {
+			if (config.output == Output::Json) {
+				write_json(output, settings(config), records);
+			} else {
+				write_csv(output, settings(config), records);
+			}
+			fclose(output);
+		}
+		if (!config.compare.empty()) {
+			std::cout << "\n";
+			return compare_records(baseline, records, config.threshold) == 0;
+		}
+		return true;
 	}
 };
 
+// Split a comma-separated list, as in "1,4,32".
+static std::vector<std::string> split(const std::string &list) {
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start < list.size()) {
+		size_t comma = list.find(',', start);
+		if (comma == std::string::npos) {
+			comma = list.size();
+		}
+		items.push_back(list.substr(start, comma - start));
+		start = comma + 1;
+	}
+	return items;
+}
+
+static std::vector<size_t> parse_list(const std::string &list) {
+	std::vector<size_t> values;
+	for (const std::string &item : split(list)) {
+		values.push_back(std::stoull(item));
+	}
+	return values;
+}
+
 int main(int argc, char *argv[]) {
 	Config config;
 
@@ -526,6 +2102,119 @@ int main(int argc, char *argv[]) {
 			config.block_size = std::stoull(argv[++i]);
 		} else if (arg == "--ops" && i + 1 < argc) {
 			config.num_operations = std::stoull(argv[++i]);
+		} else if (arg == "--iodepth" && i + 1 < argc) {
+			config.iodepth = std::max<size_t>(1, std::stoull(argv[++i]));
+		} else if (arg == "--sweep" && i + 1 < argc) {
+			config.sweep = parse_list(argv[++i]);
+		} else if (arg == "--jobs" && i + 1 < argc) {
+			std::vector<size_t> jobs = parse_list(argv[++i]);
+			if (jobs.size() == 1) {
+				config.jobs = std::max<size_t>(1, jobs[0]);
+			} else {
+				config.jobs_sweep = jobs;
+			}
+		} else if (arg == "--pin") {
+			config.pin = true;
+		} else if (arg == "--madvise" && i + 1 < argc) {
+			std::string advice = argv[++i];
+			if (advice == "normal") {
+				config.madvise = MADV_NORMAL;
+			} else if (advice == "sequential") {
+				config.madvise = MADV_SEQUENTIAL;
+			} else if (advice == "random") {
+				config.madvise = MADV_RANDOM;
+			} else if (advice == "willneed") {
+				config.madvise = MADV_WILLNEED;
+			} else {
+				std::cerr << "Unknown madvise advice: " << advice << "\n";
+				return 1;
+			}
+		} else if (arg == "--populate") {
+			config.populate = true;
+		} else if (arg == "--rwf" && i + 1 < argc) {
+			for (const std::string &flag : split(argv[++i])) {
+				if (flag == "hipri") {
+					config.rwf_flags |= RWF_HIPRI;
+				} else if (flag == "nowait") {
+					config.rwf_flags |= RWF_NOWAIT;
+				} else {
+					std::cerr << "Unknown RWF flag: " << flag << "\n";
+					return 1;
+				}
+			}
+		} else if (arg == "--sync" && i + 1 < argc) {
+			std::string list = argv[++i];
+			if (list == "all") {
+				list = "fsync,fdatasync,dsync,sync_file_range,uring";
+			}
+			for (const std::string &name : split(list)) {
+				SyncMode mode;
+				if (!parse_sync_mode(name, mode)) {
+					std::cerr << "Unknown sync mode: " << name << "\n";
+					return 1;
+				}
+				config.sync_modes.push_back(mode);
+			}
+		} else if (arg == "--sync-every" && i + 1 < argc) {
+			config.sync_every = std::max<size_t>(1, std::stoull(argv[++i]));
+		} else if (arg == "--pattern" && i + 1 < argc) {
+			if (!parse_pattern(argv[++i], config.pattern)) {
+				std::cerr << "Unknown pattern: " << argv[i] << "\n";
+				return 1;
+			}
+		} else if (arg == "--files" && i + 1 < argc) {
+			config.files = std::max<size_t>(1, std::stoull(argv[++i]));
+		} else if (arg == "--buf-ring" && i + 1 < argc) {
+			config.buf_ring = std::stoull(argv[++i]);
+		} else if (arg == "--rwmix" && i + 1 < argc) {
+			config.rwmix = std::min(100, std::max(0, std::stoi(argv[++i])));
+		} else if (arg == "--seed" && i + 1 < argc) {
+			config.seed = std::stoull(argv[++i]);
+		} else if (arg == "--runtime" && i + 1 < argc) {
+			config.runtime = std::max(0.0, std::stod(argv[++i]));
+		} else if (arg == "--ramp" && i + 1 < argc) {
+			config.ramp = std::max(0.0, std::stod(argv[++i]));
+		} else if (arg == "--rate" && i + 1 < argc) {
+			config.rate = std::max(0.0, std::stod(argv[++i]));
+		} else if (arg == "--interval" && i + 1 < argc) {
+			config.interval = std::max(0.0, std::stod(argv[++i]));
+		} else if (arg == "--uring-mode" && i + 1 < argc) {
+			std::string list = argv[++i];
+			if (list == "all") {
+				list = "interrupt,sqpoll,iopoll,sqpoll+iopoll";
+			}
+			config.ring_modes.clear();
+			for (const std::string &name : split(list)) {
+				RingMode mode;
+				if (!parse_ring_mode(name, mode)) {
+					std::cerr << "Unknown io_uring mode: " << name << "\n";
+					return 1;
+				}
+				config.ring_modes.push_back(mode);
+			}
+		} else if (arg == "--uring-flags" && i + 1 < argc) {
+			for (const std::string &name : split(argv[++i])) {
+				if (!parse_ring_flag(name, config.ring_flags)) {
+					std::cerr << "Unknown io_uring flag: " << name << "\n";
+					return 1;
+				}
+			}
+		} else if (arg == "--cache" && i + 1 < argc) {
+			if (!parse_cache_mode(argv[++i], config.cache)) {
+				std::cerr << "Unknown cache mode: " << argv[i] << "\n";
+				return 1;
+			}
+		} else if (arg == "--reuse") {
+			config.reuse = true;
+		} else if (arg == "--output" && i + 1 < argc) {
+			if (!parse_output(argv[++i], config.output)) {
+				std::cerr << "Unknown output format: " << argv[i] << "\n";
+				return 1;
+			}
+		} else if (arg == "--compare" && i + 1 < argc) {
+			config.compare = argv[++i];
+		} else if (arg == "--threshold" && i + 1 < argc) {
+			config.threshold = std::max(0.0, std::stod(argv[++i]));
 		} else if (arg == "--verbose") {
 			config.verbose = true;
 		} else if (arg == "--help") {
@@ -539,12 +2228,93 @@ int main(int argc, char *argv[]) {
 				   "4096)\n"
 				<< "  --ops <count>        Number of operations (default: "
 				   "1000)\n"
+				<< "  --iodepth <n>        I/Os in flight for AIO and "
+				   "io_uring (default: 1)\n"
+				<< "  --sweep <list>       Run every queue depth in a "
+				   "comma-separated list, e.g. 1,4,32,128\n"
+				<< "  --jobs <n|list>      Workers per engine, or a "
+				   "comma-separated list to sweep\n"
+				<< "  --pin                Pin each worker to a CPU\n"
+				<< "  --madvise <advice>   Mmap IO advice: normal, sequential, "
+				   "random or\n"
+				<< "                       willneed (default: from the "
+				   "pattern)\n"
+				<< "  --populate           Map the file with MAP_POPULATE\n"
+				<< "  --rwf <list>         Vectored IO read flags: hipri, "
+				   "nowait\n"
+				<< "  --sync <list>        Add durable-write engines: fsync, "
+				   "fdatasync, dsync,\n"
+				<< "                       sync_file_range, uring or all\n"
+				<< "  --sync-every <n>     Writes per commit (default: 1)\n"
+				<< "  --pattern <p>        Offsets: seq, rand or zipf "
+				   "(default: seq)\n"
+				<< "  --files <n>          Files per job, read and written "
+				   "side by side\n"
+				<< "                       (default: 1)\n"
+				<< "  --buf-ring <n>       Provided buffers of IOUring buf "
+				   "ring (default:\n"
+				<< "                       the queue depth)\n"
+				<< "  --rwmix <percent>    Add a mixed phase with this "
+				   "percentage of reads\n"
+				<< "  --seed <n>           Seed of the offset generator "
+				   "(default: 1)\n"
+				<< "  --runtime <s>        Run each phase this long, "
+				   "repeating the I/Os\n"
+				<< "  --ramp <s>           Leave the first seconds of each "
+				   "phase out\n"
+				<< "  --rate <iops>        Issue I/Os on a fixed schedule, "
+				   "latency counted\n"
+				<< "                       from when each was due\n"
+				<< "  --interval <s>       Progress reports of time-based "
+				   "runs (default: 1,\n"
+				<< "                       0 for none)\n"
+				<< "  --uring-mode <list>  io_uring setups: interrupt, sqpoll, "
+				   "iopoll,\n"
+				<< "                       sqpoll+iopoll or all (default: "
+				   "sqpoll)\n"
+				<< "  --uring-flags <list> Optional io_uring flags: coop, "
+				   "single, defer,\n"
+				<< "                       dropped if the kernel rejects "
+				   "them\n"
+				<< "  --cache <mode>       Page cache before each engine: drop, "
+				   "warm or keep\n"
+				<< "                       (default: drop)\n"
+				<< "  --reuse              Keep the test file, and reuse it "
+				   "if valid\n"
+				<< "  --output <format>    Results on stdout as text, json or "
+				   "csv, with the\n"
+				<< "                       text on stderr (default: text)\n"
+				<< "  --compare <file>     Compare with JSON results of an "
+				   "earlier run, exit\n"
+				<< "                       with 1 on a regression; it must have\n"
+				<< "                       been run with the same settings\n"
+				<< "  --threshold <pct>    Change counted as a regression "
+				   "(default: 10)\n"
 				<< "  --verbose            Enable verbose output\n"
 				<< "  --help               Show this help\n";
 			return 0;
 		}
 	}
 
-	BenchmarkRunner::run(config);
-	return 0;
+	if (config.sync_every > SyncIO::kMaxLinked &&
+		std::find(config.sync_modes.begin(), config.sync_modes.end(),
+				  SyncMode::UringLink) != config.sync_modes.end()) {
+		std::cerr << "--sync-every is at most " << SyncIO::kMaxLinked
+				  << " with the uring sync mode\n";
+		return 1;
+	}
+
+	size_t most_jobs = config.jobs;
+	for (size_t jobs : config.jobs_sweep) {
+		most_jobs = std::max(most_jobs, std::max<size_t>(1, jobs));
+	}
+	if (config.file_size / most_jobs / config.files < 2 * config.block_size) {
+		std::cerr << "File too small for " << most_jobs << " jobs of "
+				  << config.files << " files\n";
+		return 1;
+	}
+	std::replace(config.jobs_sweep.begin(), config.jobs_sweep.end(),
+				 (size_t)0, (size_t)1);
+
+	return BenchmarkRunner::run(config) ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,530 @@
+#pragma once
+
+// Machine-readable results: every engine, worker count, queue depth and phase
+// as one record, written as JSON or CSV along with the configuration, and
+// compared against a baseline written earlier in JSON. A small JSON reader
+// is included for the baseline; it accepts any JSON, not just ours.
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class Output { Text, Json, Csv };
+
+inline bool parse_output(const std::string &name, Output &output) {
+	if (name == "text") {
+		output = Output::Text;
+	} else if (name == "json") {
+		output = Output::Json;
+	} else if (name == "csv") {
+		output = Output::Csv;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// A configuration setting, already formatted. `quoted` values are strings.
+struct Setting {
+	std::string key;
+	std::string value;
+	bool quoted;
+};
+
+// One phase of one engine. Latencies are in microseconds. Measurements are
+// NaN when there are none, as after a failure or with no I/O completed, and
+// are written as null in JSON and left empty in CSV.
+struct Record {
+	std::string engine;
+	size_t jobs = 0;
+	size_t iodepth = 0;
+	std::string phase;
+	bool ok = false;
+	double cached = -1; // Fraction of the file cached before the run.
+	double buffer_kb = 0; // I/O buffers per worker.
+	uint64_t ops = 0;
+	double ms = NAN;
+	double iops = NAN;
+	double mb_per_s = NAN;
+	double lat_avg = NAN;
+	double lat_p50 = NAN;
+	double lat_p90 = NAN;
+	double lat_p99 = NAN;
+	double lat_p999 = NAN;
+	double lat_max = NAN;
+	double cpu_ms = NAN;
+	double cpu_us_per_io = NAN;
+};
+
+// Column names and values of a record, in output order. Missing
+// measurements have empty values.
+inline std::vector<std::pair<std::string, std::string>>
+record_fields(const Record &record) {
+	auto number = [](double value) {
+		if (!std::isfinite(value)) {
+			return std::string();
+		}
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%.6g", value);
+		return std::string(buf);
+	};
+	return {
+		{"jobs", std::to_string(record.jobs)},
+		{"iodepth", std::to_string(record.iodepth)},
+		{"ok", record.ok ? "true" : "false"},
+		{"cached", number(record.cached)},
+		{"buffer_kb", number(record.buffer_kb)},
+		{"ops", std::to_string(record.ops)},
+		{"ms", number(record.ms)},
+		{"iops", number(record.iops)},
+		{"mb_per_s", number(record.mb_per_s)},
+		{"lat_avg_us", number(record.lat_avg)},
+		{"lat_p50_us", number(record.lat_p50)},
+		{"lat_p90_us", number(record.lat_p90)},
+		{"lat_p99_us", number(record.lat_p99)},
+		{"lat_p99.9_us", number(record.lat_p999)},
+		{"lat_max_us", number(record.lat_max)},
+		{"cpu_ms", number(record.cpu_ms)},
+		{"cpu_us_per_io", number(record.cpu_us_per_io)},
+	};
+}
+
+inline std::string json_string(const std::string &value) {
+	std::string out = "\"";
+	for (char c : value) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if ((unsigned char)c < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			out += buf;
+		} else {
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+inline std::string csv_field(const std::string &value) {
+	if (value.find_first_of(",\"\n") == std::string::npos) {
+		return value;
+	}
+	std::string out = "\"";
+	for (char c : value) {
+		out += c == '"' ? "\"\"" : std::string(1, c);
+	}
+	return out + "\"";
+}
+
+inline void write_json(FILE *out, const std::vector<Setting> &config,
+					   const std::vector<Record> &records) {
+	fprintf(out, "{\n  \"config\": {");
+	for (size_t i = 0; i < config.size(); ++i) {
+		fprintf(out, "%s\n    %s: %s", i ? "," : "",
+				json_string(config[i].key).c_str(),
+				config[i].quoted ? json_string(config[i].value).c_str()
+								 : config[i].value.c_str());
+	}
+	fprintf(out, "\n  },\n  \"results\": [");
+	for (size_t i = 0; i < records.size(); ++i) {
+		fprintf(out, "%s\n    {\"engine\": %s, \"phase\": %s", i ? "," : "",
+				json_string(records[i].engine).c_str(),
+				json_string(records[i].phase).c_str());
+		for (const auto &[key, value] : record_fields(records[i])) {
+			fprintf(out, ", \"%s\": %s", key.c_str(),
+					value.empty() ? "null" : value.c_str());
+		}
+		fprintf(out, "}");
+	}
+	fprintf(out, "\n  ]\n}\n");
+}
+
+// One row per record, prefixed with the configuration so that rows from
+// different runs can be concatenated.
+inline void write_csv(FILE *out, const std::vector<Setting> &config,
+					  const std::vector<Record> &records) {
+	std::string header;
+	for (const Setting &setting : config) {
+		header += csv_field(setting.key) + ",";
+	}
+	header += "engine,phase";
+	for (const auto &field : record_fields(Record())) {
+		header += "," + field.first;
+	}
+	fprintf(out, "%s\n", header.c_str());
+
+	std::string prefix;
+	for (const Setting &setting : config) {
+		prefix += csv_field(setting.value) + ",";
+	}
+	for (const Record &record : records) {
+		std::string row = prefix + csv_field(record.engine) + "," +
+						  csv_field(record.phase);
+		for (const auto &field : record_fields(record)) {
+			row += "," + field.second;
+		}
+		fprintf(out, "%s\n", row.c_str());
+	}
+}
+
+// A parsed JSON value. Objects keep their members in order.
+struct JsonValue {
+	enum class Type { Null, Bool, Number, String, Array, Object };
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0;
+	std::string string;
+	std::vector<JsonValue> items;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	// The member `key` of an object, or nullptr.
+	const JsonValue *get(const std::string &key) const {
+		for (const auto &[name, value] : members) {
+			if (name == key) {
+				return &value;
+			}
+		}
+		return nullptr;
+	}
+};
+
+class JsonReader {
+  private:
+	const std::string &text_;
+	size_t pos_ = 0;
+
+	void skip_space() {
+		while (pos_ < text_.size() && isspace((unsigned char)text_[pos_])) {
+			++pos_;
+		}
+	}
+
+	bool consume(char c) {
+		skip_space();
+		if (pos_ < text_.size() && text_[pos_] == c) {
+			++pos_;
+			return true;
+		}
+		return false;
+	}
+
+	bool literal(const char *word) {
+		size_t length = strlen(word);
+		if (text_.compare(pos_, length, word) != 0) {
+			return false;
+		}
+		pos_ += length;
+		return true;
+	}
+
+	bool read_string(std::string &out) {
+		if (!consume('"')) {
+			return false;
+		}
+		while (pos_ < text_.size() && text_[pos_] != '"') {
+			char c = text_[pos_++];
+			if (c != '\\') {
+				out += c;
+				continue;
+			}
+			if (pos_ >= text_.size()) {
+				return false;
+			}
+			char escape = text_[pos_++];
+			switch (escape) {
+			case 'n':
+				out += '\n';
+				break;
+			case 't':
+				out += '\t';
+				break;
+			case 'r':
+				out += '\r';
+				break;
+			case 'b':
+				out += '\b';
+				break;
+			case 'f':
+				out += '\f';
+				break;
+			case 'u':
+				// Only the code points we write, below 0x80, are decoded.
+				if (pos_ + 4 > text_.size()) {
+					return false;
+				}
+				out += (char)strtoul(text_.substr(pos_, 4).c_str(), nullptr,
+									 16);
+				pos_ += 4;
+				break;
+			default:
+				out += escape;
+			}
+		}
+		return consume('"');
+	}
+
+  public:
+	explicit JsonReader(const std::string &text) : text_(text) {}
+
+	bool read(JsonValue &value) {
+		skip_space();
+		if (pos_ >= text_.size()) {
+			return false;
+		}
+		char c = text_[pos_];
+		if (c == '{') {
+			value.type = JsonValue::Type::Object;
+			++pos_;
+			if (consume('}')) {
+				return true;
+			}
+			do {
+				std::pair<std::string, JsonValue> member;
+				if (!read_string(member.first) || !consume(':') ||
+					!read(member.second)) {
+					return false;
+				}
+				value.members.push_back(std::move(member));
+			} while (consume(','));
+			return consume('}');
+		}
+		if (c == '[') {
+			value.type = JsonValue::Type::Array;
+			++pos_;
+			if (consume(']')) {
+				return true;
+			}
+			do {
+				value.items.emplace_back();
+				if (!read(value.items.back())) {
+					return false;
+				}
+			} while (consume(','));
+			return consume(']');
+		}
+		if (c == '"') {
+			value.type = JsonValue::Type::String;
+			return read_string(value.string);
+		}
+		if (literal("true") || literal("false")) {
+			value.type = JsonValue::Type::Bool;
+			value.boolean = c == 't';
+			return true;
+		}
+		if (literal("null")) {
+			return true;
+		}
+		char *end;
+		value.type = JsonValue::Type::Number;
+		value.number = strtod(text_.c_str() + pos_, &end);
+		if (end == text_.c_str() + pos_) {
+			return false;
+		}
+		pos_ = end - text_.c_str();
+		return true;
+	}
+
+	// Whether only whitespace is left.
+	bool done() {
+		skip_space();
+		return pos_ == text_.size();
+	}
+};
+
+// Read the records of a report written by `write_json`, and its
+// configuration into `config` if given.
+inline bool read_json_report(const std::string &path,
+							 std::vector<Record> &records,
+							 JsonValue *config = nullptr) {
+	std::ifstream in(path);
+	if (!in) {
+		return false;
+	}
+	std::stringstream text;
+	text << in.rdbuf();
+	std::string contents = text.str();
+	JsonReader reader(contents);
+	JsonValue root;
+	if (!reader.read(root) || !reader.done()) {
+		return false;
+	}
+	const JsonValue *results = root.get("results");
+	if (!results || results->type != JsonValue::Type::Array) {
+		return false;
+	}
+	if (config) {
+		const JsonValue *settings = root.get("config");
+		if (!settings || settings->type != JsonValue::Type::Object) {
+			return false;
+		}
+		*config = *settings;
+	}
+	for (const JsonValue &item : results->items) {
+		// Measurements written as null, or left out, read as NaN.
+		auto number = [&](const char *key) {
+			const JsonValue *value = item.get(key);
+			return value && value->type == JsonValue::Type::Number
+					   ? value->number
+					   : NAN;
+		};
+		auto count = [&](const char *key) {
+			const JsonValue *value = item.get(key);
+			return value ? static_cast<size_t>(value->number) : size_t(0);
+		};
+		auto string = [&](const char *key) {
+			const JsonValue *value = item.get(key);
+			return value ? value->string : std::string();
+		};
+		const JsonValue *ok = item.get("ok");
+		Record record;
+		record.engine = string("engine");
+		record.phase = string("phase");
+		record.jobs = count("jobs");
+		record.iodepth = count("iodepth");
+		record.ok = ok && ok->boolean;
+		record.iops = number("iops");
+		record.mb_per_s = number("mb_per_s");
+		record.lat_avg = number("lat_avg_us");
+		record.lat_p99 = number("lat_p99_us");
+		record.cpu_us_per_io = number("cpu_us_per_io");
+		records.push_back(record);
+	}
+	return true;
+}
+
+// How the settings of this run differ from `baseline`, the configuration
+// read back from a baseline report, one line per setting that differs or
+// is missing from it. The kernel may differ: comparing kernels is a use of
+// the baseline.
+inline std::vector<std::string>
+config_changes(const JsonValue &baseline,
+			   const std::vector<Setting> &config) {
+	auto format = [](const JsonValue &value) {
+		char buf[32];
+		switch (value.type) {
+		case JsonValue::Type::Bool:
+			return std::string(value.boolean ? "true" : "false");
+		case JsonValue::Type::Number:
+			snprintf(buf, sizeof(buf), "%.17g", value.number);
+			return std::string(buf);
+		case JsonValue::Type::String:
+			return value.string;
+		default:
+			return std::string("null");
+		}
+	};
+	std::vector<std::string> changes;
+	for (const Setting &setting : config) {
+		if (setting.key == "kernel") {
+			continue;
+		}
+		const JsonValue *value = baseline.get(setting.key);
+		if (!value) {
+			changes.push_back(setting.key + ": missing from the baseline, " +
+							  setting.value + " now");
+			continue;
+		}
+		bool same;
+		if (setting.quoted) {
+			same = value->type == JsonValue::Type::String &&
+				   value->string == setting.value;
+		} else if (setting.value == "true" || setting.value == "false") {
+			same = value->type == JsonValue::Type::Bool &&
+				   value->boolean == (setting.value == "true");
+		} else {
+			// Both were written from the same formatting, so equal
+			// settings read back to equal numbers.
+			same = value->type == JsonValue::Type::Number &&
+				   value->number == strtod(setting.value.c_str(), nullptr);
+		}
+		if (!same) {
+			changes.push_back(setting.key + ": " + format(*value) +
+							  " in the baseline, " + setting.value + " now");
+		}
+	}
+	return changes;
+}
+
+// Whether two records are of the same engine, worker count, queue depth and
+// phase.
+inline bool same_run(const Record &a, const Record &b) {
+	return a.engine == b.engine && a.jobs == b.jobs &&
+		   a.iodepth == b.iodepth && a.phase == b.phase;
+}
+
+// Print how every record compares to the baseline record of the same run:
+// a drop in IOPS or a rise in mean or p99 latency by more than `threshold`
+// percent is a regression, as is a failure, a measurement missing on
+// either side, or a baseline record missing from this run. Returns the
+// number of regressions.
+inline size_t compare_records(const std::vector<Record> &baseline,
+							  const std::vector<Record> &records,
+							  double threshold) {
+	auto change = [](double before, double after) {
+		return before > 0 ? (after - before) / before * 100 : 0.0;
+	};
+
+	printf("Comparison with the baseline (threshold %.1f%%):\n", threshold);
+	printf("%-30s %4s %5s %-5s %10s %10s %10s  %s\n", "Engine", "Jobs", "QD",
+		   "Phase", "IOPS", "avg lat", "p99 lat", "");
+	size_t regressions = 0;
+	for (const Record &record : records) {
+		const Record *base = nullptr;
+		for (const Record &candidate : baseline) {
+			if (same_run(candidate, record)) {
+				base = &candidate;
+				break;
+			}
+		}
+		printf("%-30s %4zu %5zu %-5s", record.engine.c_str(), record.jobs,
+			   record.iodepth, record.phase.c_str());
+		if (!base || !base->ok || !record.ok) {
+			const char *why = !base		 ? "not in the baseline"
+							  : !base->ok ? "failed in the baseline"
+										  : "failed";
+			printf(" %10s %10s %10s  %s\n", "-", "-", "-", why);
+			regressions += base && base->ok && !record.ok;
+			continue;
+		}
+		bool measured = true;
+		for (double value : {base->iops, base->lat_avg, base->lat_p99,
+							 record.iops, record.lat_avg, record.lat_p99}) {
+			measured = measured && std::isfinite(value);
+		}
+		if (!measured) {
+			printf(" %10s %10s %10s  %s\n", "-", "-", "-",
+				   "REGRESSION (not measured)");
+			++regressions;
+			continue;
+		}
+		double iops = change(base->iops, record.iops);
+		double avg = change(base->lat_avg, record.lat_avg);
+		double p99 = change(base->lat_p99, record.lat_p99);
+		bool regressed =
+			-iops > threshold || avg > threshold || p99 > threshold;
+		printf(" %+9.1f%% %+9.1f%% %+9.1f%%  %s\n", iops, avg, p99,
+			   regressed ? "REGRESSION" : "ok");
+		regressions += regressed;
+	}
+	for (const Record &base : baseline) {
+		bool found = false;
+		for (const Record &record : records) {
+			found = found || same_run(record, base);
+		}
+		if (!found && base.ok) {
+			printf("%-30s %4zu %5zu %-5s %10s %10s %10s  %s\n",
+				   base.engine.c_str(), base.jobs, base.iodepth,
+				   base.phase.c_str(), "-", "-", "-", "missing from this run");
+			++regressions;
+		}
+	}
+	return regressions;
+}
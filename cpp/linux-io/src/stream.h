@@ -0,0 +1,138 @@
+#pragma once
+
+// A worker's side of a phase: hands its engine the I/Os to issue, says when
+// each is due, and records their latencies. By default a phase is the
+// worker's I/Os once each, issued as fast as the engine can. A runtime makes
+// it cycle through them until the time is up, and a rate paces issuance on
+// a fixed schedule, open loop: latency is measured from when an I/O was due
+// rather than from when the engine got around to issuing it, so that a
+// stalled device is charged for the I/Os it held back (coordinated
+// omission). Completions during the ramp are left out of the histogram.
+
+#include "histogram.h"
+#include "workload.h"
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+inline uint64_t monotonic_ns() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+class Stream {
+  public:
+	struct Options {
+		// Run until this long after the start, or through the I/Os once if 0.
+		uint64_t runtime_ns = 0;
+		// Leave out of the histogram what completes this soon after the
+		// start.
+		uint64_t ramp_ns = 0;
+		// I/Os per second to issue, or 0 for as many as the engine can.
+		double rate = 0;
+	};
+
+  private:
+	const std::vector<IO> &ios_;
+	Options options_;
+	Histogram &latency_;
+	uint64_t start_;
+	uint64_t end_;
+	uint64_t measure_from_;
+	uint64_t last_ = 0;
+	uint64_t issued_ = 0;
+	std::atomic<uint64_t> completed_{0};
+	std::atomic<uint64_t> latency_sum_{0};
+	uint64_t measured_ = 0;
+
+	bool over(uint64_t due) const {
+		if (options_.runtime_ns == 0) {
+			return issued_ == ios_.size();
+		}
+		return due >= end_;
+	}
+
+	uint64_t due_at(uint64_t issued) const {
+		return start_ + (uint64_t)(issued * 1e9 / options_.rate);
+	}
+
+  public:
+	// Starts the clock.
+	Stream(const std::vector<IO> &ios, const Options &options,
+		   Histogram &latency)
+		: ios_(ios), options_(options), latency_(latency),
+		  start_(monotonic_ns()), end_(start_ + options.runtime_ns),
+		  measure_from_(start_ + options.ramp_ns) {}
+
+	// The next I/O to issue, or nullptr once the phase is over. `due` is set
+	// to when the I/O was due: now, or with a rate its place in the
+	// schedule, which is waited for. `flush` is called before waiting, so
+	// that I/Os the engine has prepared but not submitted are not held back.
+	template <typename Flush> const IO *next(uint64_t &due, Flush &&flush) {
+		if (ios_.empty()) {
+			return nullptr;
+		}
+		if (options_.rate > 0) {
+			due = due_at(issued_);
+			if (over(due)) {
+				return nullptr;
+			}
+			if (monotonic_ns() < due) {
+				flush();
+				timespec ts = {(time_t)(due / 1000000000ULL),
+							   (long)(due % 1000000000ULL)};
+				while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+									   nullptr) != 0) {
+				}
+			}
+		} else {
+			due = monotonic_ns();
+			if (over(due)) {
+				return nullptr;
+			}
+		}
+		return &ios_[issued_++ % ios_.size()];
+	}
+
+	const IO *next(uint64_t &due) {
+		return next(due, []() {});
+	}
+
+	// The I/O `next` would return, if it may be issued right away: for
+	// engines that coalesce adjacent I/Os. Always nullptr with a rate.
+	const IO *peek() const {
+		if (options_.rate > 0 || ios_.empty() || over(monotonic_ns())) {
+			return nullptr;
+		}
+		return &ios_[issued_ % ios_.size()];
+	}
+
+	// Record the completion, at `now`, of an I/O that was due at `due`. A
+	// `count` above 1 records that many I/Os completing together, such as a
+	// commit, with a single latency.
+	void complete(uint64_t due, uint64_t now, uint64_t count = 1) {
+		completed_.fetch_add(count, std::memory_order_relaxed);
+		latency_sum_.fetch_add((now - due) * count, std::memory_order_relaxed);
+		if (now >= measure_from_) {
+			latency_.record(now - due);
+			measured_ += count;
+			last_ = now;
+		}
+	}
+
+	// Completions so far and the sum of their latencies, for interval
+	// reports from another thread.
+	uint64_t completed() const {
+		return completed_.load(std::memory_order_relaxed);
+	}
+	uint64_t latency_sum() const {
+		return latency_sum_.load(std::memory_order_relaxed);
+	}
+
+	// Completions recorded in the histogram, and the window they fall in.
+	uint64_t measured() const { return measured_; }
+	uint64_t measure_from() const { return measure_from_; }
+	uint64_t last() const { return last_; }
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+// io_uring setup shared by the io_uring engines: how submissions and
+// completions are driven, plus optional task-running flags that are dropped
+// one by one when the kernel rejects them.
+
+#include <cerrno>
+#include <cstring>
+#include <liburing.h>
+#include <string>
+
+// Flags from kernels newer than some liburing headers.
+#ifndef IORING_SETUP_COOP_TASKRUN
+#define IORING_SETUP_COOP_TASKRUN (1U << 8)
+#endif
+#ifndef IORING_SETUP_SINGLE_ISSUER
+#define IORING_SETUP_SINGLE_ISSUER (1U << 12)
+#endif
+#ifndef IORING_SETUP_DEFER_TASKRUN
+#define IORING_SETUP_DEFER_TASKRUN (1U << 13)
+#endif
+
+// Interrupt: completions are signalled by interrupts and submissions made
+// by io_uring_enter. SQPoll: a kernel thread polls the submission queue.
+// IOPoll: completions are polled for from the device, which needs O_DIRECT.
+enum class RingMode { Interrupt, SQPoll, IOPoll, SQPollIOPoll };
+
+inline bool parse_ring_mode(const std::string &name, RingMode &mode) {
+	if (name == "interrupt") {
+		mode = RingMode::Interrupt;
+	} else if (name == "sqpoll") {
+		mode = RingMode::SQPoll;
+	} else if (name == "iopoll") {
+		mode = RingMode::IOPoll;
+	} else if (name == "sqpoll+iopoll") {
+		mode = RingMode::SQPollIOPoll;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+inline const char *ring_mode_name(RingMode mode) {
+	switch (mode) {
+	case RingMode::Interrupt:
+		return "interrupt";
+	case RingMode::SQPoll:
+		return "sqpoll";
+	case RingMode::IOPoll:
+		return "iopoll";
+	case RingMode::SQPollIOPoll:
+		return "sqpoll+iopoll";
+	}
+	return "?";
+}
+
+inline bool ring_mode_iopoll(RingMode mode) {
+	return mode == RingMode::IOPoll || mode == RingMode::SQPollIOPoll;
+}
+
+// Parse one of the optional flags: coop, single or defer.
+inline bool parse_ring_flag(const std::string &name, unsigned &flags) {
+	if (name == "coop") {
+		flags |= IORING_SETUP_COOP_TASKRUN;
+	} else if (name == "single") {
+		flags |= IORING_SETUP_SINGLE_ISSUER;
+	} else if (name == "defer") {
+		// Requires a single issuer.
+		flags |= IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+inline std::string ring_flag_names(unsigned flags) {
+	std::string names;
+	auto add = [&](unsigned flag, const char *name) {
+		if (flags & flag) {
+			names += names.empty() ? name : std::string(",") + name;
+		}
+	};
+	add(IORING_SETUP_COOP_TASKRUN, "coop");
+	add(IORING_SETUP_SINGLE_ISSUER, "single");
+	add(IORING_SETUP_DEFER_TASKRUN, "defer");
+	return names.empty() ? "none" : names;
+}
+
+// Set up `ring` with `entries` submission entries in `mode`, with as many of
+// `optional` flags as the kernel accepts: on EINVAL the flags are dropped,
+// last added first, until the setup succeeds. `used` is set to the optional
+// flags kept. Returns 0 or a negative errno.
+inline int init_ring(struct io_uring &ring, unsigned entries, RingMode mode,
+					 unsigned optional, unsigned &used) {
+	static const unsigned kDropOrder[] = {IORING_SETUP_DEFER_TASKRUN,
+										  IORING_SETUP_SINGLE_ISSUER,
+										  IORING_SETUP_COOP_TASKRUN};
+	unsigned base = 0;
+	if (mode == RingMode::SQPoll || mode == RingMode::SQPollIOPoll) {
+		base |= IORING_SETUP_SQPOLL;
+	}
+	if (ring_mode_iopoll(mode)) {
+		base |= IORING_SETUP_IOPOLL;
+	}
+
+	used = optional;
+	for (size_t dropped = 0;; ++dropped) {
+		struct io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		params.flags = base | used;
+		params.sq_thread_idle = 1000;
+		int ret = io_uring_queue_init_params(entries, &ring, &params);
+		if (ret != -EINVAL || used == 0) {
+			return ret;
+		}
+		while (dropped < 3 && !(used & kDropOrder[dropped])) {
+			++dropped;
+		}
+		if (dropped == 3) {
+			return ret;
+		}
+		used &= ~kDropOrder[dropped];
+	}
+}
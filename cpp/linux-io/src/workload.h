@@ -0,0 +1,141 @@
+#pragma once
+
+// Offset streams fed to every engine. A stream is generated once from a seed
+// and replayed by each engine in turn, so that engines are compared on the
+// same I/Os in the same order.
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+enum class Pattern { Sequential, Random, Zipf };
+
+inline bool parse_pattern(const std::string &name, Pattern &pattern) {
+	if (name == "seq") {
+		pattern = Pattern::Sequential;
+	} else if (name == "rand") {
+		pattern = Pattern::Random;
+	} else if (name == "zipf") {
+		pattern = Pattern::Zipf;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+inline const char *pattern_name(Pattern pattern) {
+	switch (pattern) {
+	case Pattern::Sequential:
+		return "seq";
+	case Pattern::Random:
+		return "rand";
+	case Pattern::Zipf:
+		return "zipf";
+	}
+	return "?";
+}
+
+struct IO {
+	off_t offset;
+	bool write;
+	// Which of the workload's files the offset falls in.
+	unsigned file;
+};
+
+// Ranks in [0, n) drawn with probability proportional to 1 / (rank + 1)^theta,
+// for 0 < theta < 1, the only range its closed form holds for. This is the method of Gray et al., "Quickly
+// Generating Billion-Record Synthetic Databases", which YCSB also uses; setup
+// is O(n) and each draw O(1).
+class ZipfGenerator {
+  private:
+	uint64_t n_;
+	double theta_;
+	double alpha_;
+	double zetan_;
+	double eta_;
+
+	static double zeta(uint64_t n, double theta) {
+		double sum = 0;
+		for (uint64_t i = 1; i <= n; ++i) {
+			sum += 1.0 / std::pow((double)i, theta);
+		}
+		return sum;
+	}
+
+  public:
+	ZipfGenerator(uint64_t n, double theta) : n_(n), theta_(theta) {
+		assert(theta > 0 && theta < 1);
+		double zeta2 = zeta(2, theta);
+		zetan_ = zeta(n, theta);
+		alpha_ = 1.0 / (1.0 - theta);
+		eta_ = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan_);
+	}
+
+	template <typename Rng> uint64_t operator()(Rng &rng) {
+		double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+		double uz = u * zetan_;
+		if (uz < 1.0) {
+			return 0;
+		}
+		if (uz < 1.0 + std::pow(0.5, theta_)) {
+			return 1;
+		}
+		uint64_t rank = (uint64_t)(n_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+		return rank < n_ ? rank : n_ - 1;
+	}
+};
+
+// Scatter Zipf ranks over the file, so that the hot blocks are not all packed
+// at its start, where readahead would serve them (SplitMix64 finalizer).
+inline uint64_t scatter(uint64_t rank) {
+	uint64_t z = rank + 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// `count` block-aligned I/Os within a file of `file_size` bytes, split into
+// `files` equal parts standing for as many files. With `read_percent` at 100
+// every I/O is a read, at 0 every one is a write, and in between reads and
+// writes are interleaved at random. Sequential offsets go through the files
+// side by side, one block of each in turn, as when reading them all at once,
+// and wrap around before the last block of each.
+inline std::vector<IO> make_workload(Pattern pattern, size_t file_size,
+									 size_t block_size, size_t files,
+									 size_t count, unsigned read_percent,
+									 uint64_t seed, double theta) {
+	std::mt19937_64 rng(seed);
+	uint64_t blocks = file_size / block_size;
+	uint64_t part = blocks / files * block_size;
+	std::uniform_int_distribution<uint64_t> uniform(0, blocks - 1);
+	std::uniform_int_distribution<unsigned> percent(0, 99);
+	std::optional<ZipfGenerator> zipf;
+	if (pattern == Pattern::Zipf) {
+		zipf.emplace(blocks, theta);
+	}
+
+	std::vector<IO> ios(count);
+	for (size_t i = 0; i < count; ++i) {
+		switch (pattern) {
+		case Pattern::Sequential:
+			ios[i].offset = i % files * part +
+							(i / files * block_size) % (part - block_size);
+			break;
+		case Pattern::Random:
+			ios[i].offset = uniform(rng) * block_size;
+			break;
+		case Pattern::Zipf:
+			ios[i].offset = scatter((*zipf)(rng)) % blocks * block_size;
+			break;
+		}
+		ios[i].file = std::min<uint64_t>(ios[i].offset / part, files - 1);
+		ios[i].write = percent(rng) >= read_percent;
+	}
+	return ios;
+}
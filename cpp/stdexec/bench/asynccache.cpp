@@ -0,0 +1,83 @@
+// Latency of cache hits through `asynccache::async_get` compared to the
+// synchronous `TimeLRUCache::Get`, plus read-through misses served on a
+// `run_loop` worker.
+#include "asynccache.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace stdex = stdexec;
+
+using Cache = TimeLRUCache<int, std::string, 10>;
+
+constexpr int kKeys = 1024;
+
+template <typename Func> double NsPerOp(int ops, Func &&func) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; ++i) {
+		func(i);
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+int main(int argc, char *argv[]) {
+	int ops = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+	stdex::run_loop loop;
+	std::thread worker([&loop] { loop.run(); });
+	auto scheduler = loop.get_scheduler();
+	auto loader = [](const int &key) {
+		return stdex::just("loaded" + std::to_string(key));
+	};
+
+	Cache cache;
+	for (int key = 0; key < kKeys; ++key) {
+		cache.Put(key, "value" + std::to_string(key), 10);
+	}
+
+	size_t found = 0;
+	double get = NsPerOp(ops, [&](int i) {
+		found += cache.Get(i % kKeys) != nullptr;
+	});
+	double getCopy = NsPerOp(ops, [&](int i) {
+		found += cache.GetCopy(i % kKeys).has_value();
+	});
+	double asyncGet = NsPerOp(ops, [&](int i) {
+		auto [value] =
+			stdex::sync_wait(asynccache::async_get(cache, i % kKeys)).value();
+		found += value.has_value();
+	});
+	double readThroughHit = NsPerOp(ops, [&](int i) {
+		auto [value] = stdex::sync_wait(asynccache::async_get(
+											cache, i % kKeys, scheduler,
+											loader, 10))
+						   .value();
+		found += !value.empty();
+	});
+
+	// Every key is new, so each lookup is served by the loader on `worker`.
+	int misses = ops / 10;
+	double readThroughMiss = NsPerOp(misses, [&](int i) {
+		auto [value] = stdex::sync_wait(asynccache::async_get(
+											cache, kKeys + i, scheduler,
+											loader, 10))
+						   .value();
+		found += !value.empty();
+	});
+
+	loop.finish();
+	worker.join();
+
+	std::cout << "Cache lookup latency (ns/op), " << ops << " hits, " << misses
+			  << " misses\n";
+	std::cout << "  Get:                          " << get << "\n";
+	std::cout << "  GetCopy:                      " << getCopy << "\n";
+	std::cout << "  async_get hit:                " << asyncGet << "\n";
+	std::cout << "  read-through async_get hit:   " << readThroughHit << "\n";
+	std::cout << "  read-through async_get miss:  " << readThroughMiss << "\n";
+	std::cout << "  (" << found << " values found)\n";
+	return 0;
+}
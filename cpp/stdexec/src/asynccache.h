@@ -0,0 +1,91 @@
+#pragma once
+
+#include "timelru.h"
+#include <exec/variant_sender.hpp>
+#include <optional>
+#include <stdexec/execution.hpp>
+#include <utility>
+
+// Sender-based access to `TimeLRUCache`.
+//
+// Cache operations only take the cache mutex for a map lookup, so they
+// complete inline on the thread that starts them. Only the loader of a
+// read-through `async_get` is moved to a scheduler, which lets lookups be
+// pipelined with backend I/O without blocking the caller.
+namespace asynccache {
+
+namespace stdex = stdexec;
+
+// Keys and values are taken as the cache's own types, which are not deduced
+// from the arguments, so that e.g. a string literal converts to a
+// `std::string` key.
+template <typename Cache> using KeyOf = typename Cache::key_type;
+template <typename Cache> using ValueOf = typename Cache::mapped_type;
+
+// Sender of a copy of the value cached under `key`, or `std::nullopt`.
+template <typename Key, typename Value, size_t SlotNum>
+stdex::sender auto
+async_get(TimeLRUCache<Key, Value, SlotNum> &cache,
+		  const KeyOf<TimeLRUCache<Key, Value, SlotNum>> &key) {
+	return stdex::just(Key(key)) |
+		   stdex::then([&cache](const Key &key) { return cache.GetCopy(key); });
+}
+
+// Sender that puts `value` under `key` and completes once it is cached.
+template <typename Key, typename Value, size_t SlotNum>
+stdex::sender auto
+async_put(TimeLRUCache<Key, Value, SlotNum> &cache,
+		  const KeyOf<TimeLRUCache<Key, Value, SlotNum>> &key,
+		  ValueOf<TimeLRUCache<Key, Value, SlotNum>> value, size_t interval) {
+	return stdex::just(Key(key), std::move(value)) |
+		   stdex::then([&cache, interval](Key &&key, Value &&value) {
+			   cache.Put(std::move(key), std::move(value), interval);
+		   });
+}
+
+namespace detail {
+
+// Run `loader(key)` on `scheduler` and cache what it produces. The key and
+// loader are copied into the sender, which may run after the caller's
+// copies are gone.
+template <typename Key, typename Value, size_t SlotNum,
+		  stdex::scheduler Scheduler, typename Loader>
+stdex::sender auto load(TimeLRUCache<Key, Value, SlotNum> &cache,
+						const KeyOf<TimeLRUCache<Key, Value, SlotNum>> &key,
+						Scheduler scheduler,
+						const Loader &loader, size_t interval) {
+	return stdex::schedule(scheduler) |
+		   stdex::let_value([key, loader]() { return loader(key); }) |
+		   stdex::then([&cache, key, interval](Value value) {
+			   cache.Put(key, value, interval);
+			   return value;
+		   });
+}
+
+} // namespace detail
+
+// Read-through lookup. On a hit the sender completes inline with the cached
+// value. On a miss it transfers to `scheduler`, starts the sender returned by
+// `loader(key)`, caches its value for `interval` seconds and completes with
+// it on whatever context the loader completed on.
+template <typename Key, typename Value, size_t SlotNum,
+		  stdex::scheduler Scheduler, typename Loader>
+stdex::sender auto
+async_get(TimeLRUCache<Key, Value, SlotNum> &cache,
+		  const KeyOf<TimeLRUCache<Key, Value, SlotNum>> &key,
+		  Scheduler scheduler, Loader loader, size_t interval) {
+	using Hit = decltype(stdex::just(std::declval<Value>()));
+	using Miss = decltype(detail::load(cache, std::declval<const Key &>(),
+									   scheduler, loader, interval));
+	return stdex::let_value(
+		stdex::just(Key(key)),
+		[&cache, scheduler, loader = std::move(loader),
+		 interval](const Key &key) -> exec::variant_sender<Hit, Miss> {
+			if (auto value = cache.GetCopy(key)) {
+				return stdex::just(std::move(*value));
+			}
+			return detail::load(cache, key, scheduler, loader, interval);
+		});
+}
+
+} // namespace asynccache
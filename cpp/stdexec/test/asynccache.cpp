@@ -0,0 +1,83 @@
+#include "asynccache.h"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace stdex = stdexec;
+
+using Cache = TimeLRUCache<std::string, std::string, 10>;
+
+void testAsyncGetPut() {
+	std::cout << "=== Testing async_get and async_put ===" << std::endl;
+	Cache cache;
+
+	// Keys convert to the cache's key type, as they would for `Put`.
+	stdex::sync_wait(asynccache::async_put(cache, "key1", "value1", 10));
+	auto [value] =
+		stdex::sync_wait(asynccache::async_get(cache, "key1")).value();
+	assert(value == "value1");
+
+	auto [missing] =
+		stdex::sync_wait(asynccache::async_get(cache, "nonexistent")).value();
+	assert(!missing.has_value());
+
+	std::cout << "async_get and async_put test passed!" << std::endl;
+}
+
+void testReadThrough() {
+	std::cout << "\n=== Testing read-through async_get ===" << std::endl;
+	Cache cache;
+	stdex::run_loop loop;
+	std::thread worker([&loop] { loop.run(); });
+	std::atomic<int> loads{0};
+	std::thread::id loadedOn;
+	auto loader = [&](const std::string &key) {
+		++loads;
+		loadedOn = std::this_thread::get_id();
+		return stdex::just("loaded_" + key);
+	};
+	std::thread::id completedOn;
+	auto get = [&](std::string key) {
+		// The key is a temporary the sender must not refer to.
+		return asynccache::async_get(cache, key, loop.get_scheduler(), loader,
+									 10) |
+			   stdex::then([&](std::string value) {
+				   completedOn = std::this_thread::get_id();
+				   return value;
+			   });
+	};
+
+	// A hit completes inline, without the loader.
+	cache.Put("key1", "value1", 10);
+	auto [hit] = stdex::sync_wait(get("key1")).value();
+	assert(hit == "value1");
+	assert(loads == 0);
+	assert(completedOn == std::this_thread::get_id());
+
+	// A miss loads on the scheduler's thread, then caches the value.
+	auto [miss] = stdex::sync_wait(get("key2")).value();
+	assert(miss == "loaded_key2");
+	assert(loads == 1);
+	assert(loadedOn == worker.get_id());
+	assert(cache.GetCopy("key2") == "loaded_key2");
+
+	// A later lookup of the loaded key is a hit.
+	auto [later] = stdex::sync_wait(get("key2")).value();
+	assert(later == "loaded_key2");
+	assert(loads == 1);
+	assert(completedOn == std::this_thread::get_id());
+
+	loop.finish();
+	worker.join();
+	std::cout << "Read-through async_get test passed!" << std::endl;
+}
+
+int main() {
+	testAsyncGetPut();
+	testReadThrough();
+
+	std::cout << "\n=== All asynccache tests completed ===" << std::endl;
+	return 0;
+}
@@ -0,0 +1,63 @@
+// Put throughput of `TimeLRUCache` with and without a removal listener.
+//
+// Every Put after the first round overwrites an existing key, so each one
+// produces a `Replaced` removal. The listener does nothing, which isolates
+// the cost of queueing and delivering removals. The time wheel is not
+// started: a run is shorter than the time to live, so no entry would expire
+// anyway, and each Put still pays for queueing its timer task.
+#include "timelru.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using Cache = TimeLRUCache<int, int, 10>;
+
+constexpr int kKeys = 1024;
+
+double BenchPut(Cache &cache, int threads, int putsPerThread) {
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t) {
+		workers.emplace_back([&cache, t, putsPerThread]() {
+			for (int i = 0; i < putsPerThread; ++i) {
+				cache.Put((i + t) % kKeys, i, 10);
+			}
+		});
+	}
+	for (auto &worker : workers) {
+		worker.join();
+	}
+	auto end = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+	return threads * putsPerThread / seconds;
+}
+
+int main(int argc, char *argv[]) {
+	int putsPerThread = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+	std::cout << "Put throughput (Mops/s), " << putsPerThread
+			  << " puts per thread, " << kKeys << " keys\n";
+	std::cout << "threads  no listener  batch 1  batch 64  batch 1024\n";
+	for (int threads : {1, 2, 4}) {
+		std::cout << threads;
+		for (size_t batchSize : {size_t(0), size_t(1), size_t(64),
+								 size_t(1024)}) {
+			size_t delivered = 0;
+			Cache cache;
+			if (batchSize > 0) {
+				cache.SetRemovalListener(
+					[&delivered](std::vector<Cache::Removal> &batch) {
+						delivered += batch.size();
+					},
+					batchSize);
+			}
+			double opsPerSecond = BenchPut(cache, threads, putsPerThread);
+			cache.Flush();
+			std::cout << "  " << opsPerSecond / 1e6;
+		}
+		std::cout << std::endl;
+	}
+	return 0;
+}
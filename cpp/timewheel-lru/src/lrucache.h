@@ -1,6 +1,17 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <map>
+#include <utility>
+
+// Why an entry left the cache.
+enum class RemovalCause {
+	Capacity, // Evicted as the least recently used entry.
+	Expired,  // Its time to live ran out.
+	Explicit, // Evicted by key.
+	Replaced, // Its value was overwritten by `Put`.
+};
 
 template <typename T> struct LinkNode {
 	T data;
@@ -31,13 +42,17 @@ template <typename Key, typename Value> struct LRUCache {
 	using KeyValue = std::pair<Key, Value>;
 	LinkList<KeyValue> list;
 	std::map<Key, LinkNode<KeyValue> *> map;
+	// Called with every entry leaving the cache, right before it is
+	// destroyed. The entry may be moved from. Empty by default.
+	std::function<void(KeyValue &&, RemovalCause)> onRemoval;
 
 	size_t Size() const;
 
 	// Put a key-value pair into the cache.
-	// If the cache already contains the key, update the value.
+	// If the cache already contains the key, update the value. Returns the
+	// stored value, valid until the entry leaves the cache.
 	// TODO: If key and value are not copy-constructible and assignable?
-	void Put(Key key, Value value);
+	Value &Put(Key key, Value value);
 
 	// Try to put a key-value pair into the cache
 	// If the cache already contains the key, return false.
@@ -57,7 +72,7 @@ template <typename Key, typename Value> struct LRUCache {
 	void Evict();
 
 	// Evict specific key from the cache.
-	void Evict(const Key &key);
+	void Evict(const Key &key, RemovalCause cause = RemovalCause::Explicit);
 };
 
 template <typename T> LinkList<T>::LinkList() {
@@ -126,14 +141,19 @@ size_t LRUCache<Key, Value>::Size() const {
 }
 
 template <typename Key, typename Value>
-void LRUCache<Key, Value>::Put(Key key, Value value) {
-	if (map.find(key) != map.end()) {
-		auto node = map.at(key);
+Value &LRUCache<Key, Value>::Put(Key key, Value value) {
+	auto it = map.find(key);
+	if (it != map.end()) {
+		auto node = it->second;
+		if (onRemoval) {
+			onRemoval(std::move(node->data), RemovalCause::Replaced);
+		}
 		node->data = std::make_pair(std::move(key), std::move(value));
-	} else {
-		list.PushFront(std::make_pair(key, value));
-		map.emplace(std::move(key), list.head->next);
+		return node->data.second;
 	}
+	list.PushFront(std::make_pair(key, std::move(value)));
+	map.emplace(std::move(key), list.head->next);
+	return list.head->next->data.second;
 }
 
 template <typename Key, typename Value>
@@ -141,7 +161,7 @@ bool LRUCache<Key, Value>::TryPut(Key key, Value value) {
 	if (map.find(key) != map.end()) {
 		return false;
 	} else {
-		list.PushBack(std::make_pair(key, value));
+		list.PushBack(std::make_pair(key, std::move(value)));
 		map.emplace(std::move(key), list.tail);
 		return true;
 	}
@@ -172,15 +192,21 @@ template <typename Key, typename Value> void LRUCache<Key, Value>::Evict() {
 	}
 	auto node = list.tail;
 	map.erase(node->data.first);
+	if (onRemoval) {
+		onRemoval(std::move(node->data), RemovalCause::Capacity);
+	}
 	list.PopBack();
 }
 
 template <typename Key, typename Value>
-void LRUCache<Key, Value>::Evict(const Key &key) {
+void LRUCache<Key, Value>::Evict(const Key &key, RemovalCause cause) {
 	auto it = map.find(key);
 	if (it != map.end()) {
 		auto node = it->second;
 		map.erase(it);
+		if (onRemoval) {
+			onRemoval(std::move(node->data), cause);
+		}
 		list.Delete(node);
 	}
 }
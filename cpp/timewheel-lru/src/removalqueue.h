@@ -0,0 +1,83 @@
+#pragma once
+
+#include "lrucache.h"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Queue of removed cache entries handed to a listener in batches.
+//
+// `Push` is called while the owner holds its own lock and only appends to
+// `pending`. `Deliver` is called after that lock is released, so a slow
+// listener never extends the owner's critical sections. At most one thread
+// runs the listener at a time, which keeps batches in removal order.
+template <typename Key, typename Value> struct RemovalQueue {
+	struct Removal {
+		Key key;
+		Value value;
+		RemovalCause cause;
+	};
+	using Listener = std::function<void(std::vector<Removal> &)>;
+
+	// Must be set before the queue is shared between threads.
+	Listener listener;
+	size_t batchSize = 1;
+
+	std::vector<Removal> pending;
+	std::atomic<size_t> count{0};
+	std::mutex mutex; // Guards `pending`.
+	std::mutex delivering;
+
+	void Push(Key key, Value value, RemovalCause cause);
+
+	// Hand pending removals to the listener once at least `batchSize` of them
+	// are queued. If another thread is delivering, leave them to it.
+	void Deliver();
+
+	// Hand all pending removals to the listener regardless of `batchSize`.
+	void Flush();
+
+  private:
+	void Deliver(size_t threshold);
+};
+
+template <typename Key, typename Value>
+void RemovalQueue<Key, Value>::Push(Key key, Value value, RemovalCause cause) {
+	std::scoped_lock<std::mutex> lock(mutex);
+	pending.push_back(Removal{std::move(key), std::move(value), cause});
+	count.store(pending.size(), std::memory_order_relaxed);
+}
+
+template <typename Key, typename Value>
+void RemovalQueue<Key, Value>::Deliver() {
+	Deliver(batchSize);
+}
+
+template <typename Key, typename Value> void RemovalQueue<Key, Value>::Flush() {
+	Deliver(1);
+}
+
+template <typename Key, typename Value>
+void RemovalQueue<Key, Value>::Deliver(size_t threshold) {
+	std::vector<Removal> batch;
+	// Removals pushed while the listener runs are picked up by the next
+	// iteration, so a thread that fails to take `delivering` can leave.
+	while (listener && count.load(std::memory_order_relaxed) >= threshold &&
+		   count.load(std::memory_order_relaxed) > 0) {
+		std::unique_lock<std::mutex> guard(delivering, std::try_to_lock);
+		if (!guard.owns_lock()) {
+			return;
+		}
+		{
+			std::scoped_lock<std::mutex> lock(mutex);
+			batch.swap(pending);
+			count.store(0, std::memory_order_relaxed);
+		}
+		if (!batch.empty()) {
+			listener(batch);
+		}
+		batch.clear();
+	}
+}
@@ -1,4 +1,5 @@
 #include "timelru.h"
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <iostream>
@@ -172,11 +173,131 @@ void testTimeLRUConstMethods() {
 	auto nonexistent = constCache.Get("nonexistent");
 	assert(nonexistent == nullptr);
 
+	auto copy = constCache.GetCopy("test");
+	assert(copy.has_value() && *copy == "value");
+	assert(!constCache.GetCopy("nonexistent").has_value());
+
 	std::cout << "TimeLRU const methods test passed!" << std::endl;
 	cache.Stop();
 	thread.join();
 }
 
+void testTimeLRURemovalListener() {
+	std::cout << "\n=== Testing TimeLRU Removal Listener ===" << std::endl;
+	using Cache = TimeLRUCache<std::string, std::string, 10>;
+	Cache cache;
+	std::vector<Cache::Removal> removed;
+	size_t batches = 0;
+	cache.SetRemovalListener(
+		[&](std::vector<Cache::Removal> &batch) {
+			// Delivered without the cache lock held.
+			(void)cache.Size();
+			for (auto &removal : batch) {
+				removed.push_back(std::move(removal));
+			}
+			++batches;
+		},
+		3);
+	auto thread = StartTimer(cache);
+
+	cache.Put("key1", "value1", 10);
+	cache.Put("key2", "value2", 10);
+	cache.Put("key1", "value1_updated", 10); // Replaced
+	cache.Evict("key2");					 // Explicit
+	assert(removed.empty()); // Batch of 3 not reached yet
+
+	cache.Put("short", "value3", 1);
+	cache.Evict(); // Capacity, evicts the least recently used "key1"
+	assert(batches == 1);
+	assert(removed.size() == 3);
+	assert(removed[0].key == "key1" && removed[0].value == "value1");
+	assert(removed[0].cause == RemovalCause::Replaced);
+	assert(removed[1].key == "key2" && removed[1].value == "value2");
+	assert(removed[1].cause == RemovalCause::Explicit);
+	assert(removed[2].key == "key1" && removed[2].value == "value1_updated");
+	assert(removed[2].cause == RemovalCause::Capacity);
+
+	// Wait for "short" to expire, then deliver the incomplete batch.
+	std::this_thread::sleep_for(std::chrono::seconds(2));
+	assert(cache.Size() == 0);
+	cache.Flush();
+	assert(batches == 2);
+	assert(removed.size() == 4);
+	assert(removed[3].key == "short" && removed[3].value == "value3");
+	assert(removed[3].cause == RemovalCause::Expired);
+
+	std::cout << "TimeLRU removal listener test passed!" << std::endl;
+	cache.Stop();
+	thread.join();
+}
+
+void testTimeLRUFlushOnDestruction() {
+	std::cout << "\n=== Testing TimeLRU Flush On Destruction ===" << std::endl;
+	using Cache = TimeLRUCache<std::string, std::string, 10>;
+	std::vector<Cache::Removal> removed;
+	{
+		Cache cache;
+		cache.SetRemovalListener(
+			[&](std::vector<Cache::Removal> &batch) {
+				for (auto &removal : batch) {
+					removed.push_back(std::move(removal));
+				}
+			},
+			3);
+		auto thread = StartTimer(cache);
+
+		cache.Put("key1", "value1", 10);
+		cache.Put("key2", "value2", 10);
+		cache.Evict("key1");
+		cache.Evict("key2");
+		assert(removed.empty()); // Batch of 3 not reached yet
+
+		cache.Stop();
+		thread.join();
+	}
+	// The partial batch is delivered when the cache goes away.
+	assert(removed.size() == 2);
+	assert(removed[0].key == "key1" && removed[0].value == "value1");
+	assert(removed[1].key == "key2" && removed[1].value == "value2");
+
+	std::cout << "TimeLRU flush on destruction test passed!" << std::endl;
+}
+
+void testTimeLRURefreshedTTL() {
+	std::cout << "\n=== Testing TimeLRU Refreshed TTL ===" << std::endl;
+	using Cache = TimeLRUCache<std::string, std::string, 10>;
+	Cache cache;
+	std::atomic<int> expired{0};
+	cache.SetRemovalListener(
+		[&](std::vector<Cache::Removal> &batch) {
+			for (auto &removal : batch) {
+				expired += removal.cause == RemovalCause::Expired;
+			}
+		},
+		1);
+	auto thread = StartTimer(cache);
+
+	// The wheel ticks about every second from its start. The first Put
+	// expires on the second tick, the second one on the third.
+	cache.Put("key", "value1", 2);
+	std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+	cache.Put("key", "value2", 2);
+
+	// Past the first deadline: the stale task must not expire the entry.
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	assert(expired == 0);
+	assert(cache.GetCopy("key") == "value2");
+
+	// Past the second deadline.
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	assert(expired == 1);
+	assert(cache.Size() == 0);
+
+	std::cout << "TimeLRU refreshed TTL test passed!" << std::endl;
+	cache.Stop();
+	thread.join();
+}
+
 int main() {
 	testBasicTimeLRUOperations();
 	testTimeLRUTryPut();
@@ -184,6 +305,9 @@ int main() {
 	testTimeLRUThreadSafety();
 	testTimeLRUTimeBasedEviction();
 	testTimeLRUConstMethods();
+	testTimeLRURemovalListener();
+	testTimeLRUFlushOnDestruction();
+	testTimeLRURefreshedTTL();
 
 	std::cout << "\n=== All TimeLRU tests completed ===" << std::endl;
 	return 0;
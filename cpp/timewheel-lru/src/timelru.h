@@ -1,9 +1,13 @@
 #pragma once
 
 #include "lrucache.h"
+#include "removalqueue.h"
 #include "timewheel.h"
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <vector>
 
 template <typename Key, typename Value, size_t SlotNum>
@@ -12,18 +16,45 @@ struct TimeLRUCache
 	struct TimerTask {
 		Key key;
 		TimeLRUCache<Key, Value, SlotNum> *cache;
-		TimerTask(Key k, TimeLRUCache<Key, Value, SlotNum> *c)
-			: key(std::move(k)), cache(c) {}
+		// Tells this task apart from later ones of the same key.
+		uint64_t generation;
+		TimerTask(Key k, TimeLRUCache<Key, Value, SlotNum> *c, uint64_t g)
+			: key(std::move(k)), cache(c), generation(g) {}
 		void Evict();
 	};
 
+	using key_type = Key;
+	using mapped_type = Value;
+	using Removal = typename RemovalQueue<Key, Value>::Removal;
+	using RemovalListener = typename RemovalQueue<Key, Value>::Listener;
+
 	LRUCache<Key, Value> cache;
 	TimeWheel<TimerTask, SlotNum, std::vector> timeWheel;
 	// TODO: Use fine-grained locking like a thread safe map.
 	mutable std::mutex mutex;
+	RemovalQueue<Key, Value> removals;
+	// Generation of the pending timer task of each key. Putting a key again
+	// schedules a new task and leaves the earlier ones stale, so only the
+	// latest time to live counts. Guarded by `mutex`.
+	std::map<Key, uint64_t> generations;
+	uint64_t lastGeneration = 0;
+
+	// Stops the time wheel and delivers removals still waiting for a full
+	// batch, so that none are lost with the cache. The timer thread must not
+	// touch the cache any more, nor may the listener outlive what it uses.
+	~TimeLRUCache();
 
 	size_t Size() const;
 
+	// Report every entry leaving the cache to `listener`, in batches of at
+	// least `batchSize` removals. The listener runs without `mutex` held, so
+	// it may call back into the cache. Must be called before the cache is
+	// shared between threads.
+	void SetRemovalListener(RemovalListener listener, size_t batchSize = 64);
+
+	// Deliver removals still waiting for a full batch.
+	void Flush();
+
 	void Start();
 	void Stop();
 
@@ -33,7 +64,8 @@ struct TimeLRUCache
 	void Put(Key key, Value value, size_t interval);
 
 	// Try to put a key-value pair into the cache
-	// If the cache already contains the key, return false.
+	// If the cache already contains the key, return false and leave its time
+	// to live as it was.
 	bool TryPut(Key key, Value value, size_t interval);
 
 	// Get the reference of the value associated with the key.
@@ -46,19 +78,54 @@ struct TimeLRUCache
 	// C++26 standard.
 	Value *Get(const Key &key);
 
+	// Get a copy of the value associated with the key. Unlike `Get`, the
+	// result stays valid after the entry is evicted.
+	std::optional<Value> GetCopy(const Key &key) const;
+
 	// Evict a cache slot. If the cache is empty, do nothing.
 	void Evict();
 
 	// Evict specific key from the cache.
 	void Evict(const Key &key);
+
+	// Evict specific key from the cache once its time to live ran out,
+	// unless the timer task of `generation` was superseded by a later Put.
+	void Expire(const Key &key, uint64_t generation);
+
+	// Schedule the expiry of `key` in `interval` seconds, superseding any
+	// earlier one. Called with `mutex` held.
+	void Schedule(Key key, size_t interval);
 };
 
+template <typename Key, typename Value, size_t SlotNum>
+TimeLRUCache<Key, Value, SlotNum>::~TimeLRUCache() {
+	Stop();
+	removals.Flush();
+}
+
 template <typename Key, typename Value, size_t SlotNum>
 size_t TimeLRUCache<Key, Value, SlotNum>::Size() const {
 	std::scoped_lock<std::mutex> lock(mutex);
 	return cache.Size();
 }
 
+template <typename Key, typename Value, size_t SlotNum>
+void TimeLRUCache<Key, Value, SlotNum>::SetRemovalListener(
+	RemovalListener listener, size_t batchSize) {
+	std::scoped_lock<std::mutex> lock(mutex);
+	removals.listener = std::move(listener);
+	removals.batchSize = batchSize;
+	cache.onRemoval = [this](std::pair<Key, Value> &&entry,
+							 RemovalCause cause) {
+		removals.Push(std::move(entry.first), std::move(entry.second), cause);
+	};
+}
+
+template <typename Key, typename Value, size_t SlotNum>
+void TimeLRUCache<Key, Value, SlotNum>::Flush() {
+	removals.Flush();
+}
+
 template <typename Key, typename Value, size_t SlotNum>
 void TimeLRUCache<Key, Value, SlotNum>::Start() {
 	timeWheel.Start();
@@ -72,20 +139,36 @@ void TimeLRUCache<Key, Value, SlotNum>::Stop() {
 template <typename Key, typename Value, size_t SlotNum>
 void TimeLRUCache<Key, Value, SlotNum>::Put(Key key, Value value,
 											size_t interval) {
-	std::scoped_lock<std::mutex> lock(mutex);
-	cache.Put(key, value);
-	timeWheel.AddTask(TimerTask{std::move(key), this}, interval);
+	{
+		std::scoped_lock<std::mutex> lock(mutex);
+		cache.Put(key, std::move(value));
+		Schedule(std::move(key), interval);
+	}
+	removals.Deliver();
 }
 
 template <typename Key, typename Value, size_t SlotNum>
 bool TimeLRUCache<Key, Value, SlotNum>::TryPut(Key key, Value value,
 											   size_t interval) {
 	std::scoped_lock<std::mutex> lock(mutex);
-	auto res = cache.TryPut(key, value);
-	timeWheel.AddTask(TimerTask{std::move(key), this}, interval);
+	auto res = cache.TryPut(key, std::move(value));
+	if (res) {
+		Schedule(std::move(key), interval);
+	}
 	return res;
 }
 
+template <typename Key, typename Value, size_t SlotNum>
+void TimeLRUCache<Key, Value, SlotNum>::Schedule(Key key, size_t interval) {
+	uint64_t current = ++lastGeneration;
+	if (timeWheel.AddTask(TimerTask{key, this, current}, interval)) {
+		generations.insert_or_assign(std::move(key), current);
+	} else {
+		// Never expires; earlier tasks are stale all the same.
+		generations.erase(key);
+	}
+}
+
 // TODO: Value returend may be invalidated after the timer task runs or `Evict`
 // is called. Should use a `Pin` or `std::shared_ptr` to ensure the value is
 // valid.
@@ -105,18 +188,49 @@ Value *TimeLRUCache<Key, Value, SlotNum>::Get(const Key &key) {
 }
 
 template <typename Key, typename Value, size_t SlotNum>
-void TimeLRUCache<Key, Value, SlotNum>::Evict() {
+std::optional<Value>
+TimeLRUCache<Key, Value, SlotNum>::GetCopy(const Key &key) const {
 	std::scoped_lock<std::mutex> lock(mutex);
-	cache.Evict();
+	if (auto value = cache.Get(key)) {
+		return *value;
+	}
+	return std::nullopt;
+}
+
+template <typename Key, typename Value, size_t SlotNum>
+void TimeLRUCache<Key, Value, SlotNum>::Evict() {
+	{
+		std::scoped_lock<std::mutex> lock(mutex);
+		cache.Evict();
+	}
+	removals.Deliver();
 }
 
 template <typename Key, typename Value, size_t SlotNum>
 void TimeLRUCache<Key, Value, SlotNum>::Evict(const Key &key) {
-	std::scoped_lock<std::mutex> lock(mutex);
-	cache.Evict(key);
+	{
+		std::scoped_lock<std::mutex> lock(mutex);
+		cache.Evict(key);
+	}
+	removals.Deliver();
+}
+
+template <typename Key, typename Value, size_t SlotNum>
+void TimeLRUCache<Key, Value, SlotNum>::Expire(const Key &key,
+											   uint64_t generation) {
+	{
+		std::scoped_lock<std::mutex> lock(mutex);
+		auto it = generations.find(key);
+		if (it == generations.end() || it->second != generation) {
+			return;
+		}
+		generations.erase(it);
+		cache.Evict(key, RemovalCause::Expired);
+	}
+	removals.Deliver();
 }
 
 template <typename Key, typename Value, size_t SlotNum>
 void TimeLRUCache<Key, Value, SlotNum>::TimerTask::Evict() {
-	cache->Evict(key);
+	cache->Expire(key, generation);
 }
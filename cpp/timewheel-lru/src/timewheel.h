@@ -3,6 +3,7 @@
 #include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <mutex>
 #include <unistd.h>
 
 template <typename T, size_t SlotNum, template <typename> typename Container>
@@ -10,29 +11,40 @@ struct TimeWheel {
 	Container<Container<T>> slots;
 	size_t times;
 	std::atomic<bool> stop;
+	// Guards `slots` and `times`, which `AddTask` and the ticking thread
+	// share. Not held while due tasks run, since they may add tasks.
+	std::mutex mutex;
 
 	TimeWheel() : slots(SlotNum), times(0), stop(false) {}
 	void Start();
 	void Stop() { stop.store(true); }
-	void AddTask(T task, size_t interval);
+	// Run `task` in `interval` ticks. Returns false, dropping the task, if
+	// that is beyond one turn of the wheel.
+	bool AddTask(T task, size_t interval);
 };
 
 template <typename T, size_t SlotNum, template <typename> typename Container>
 void TimeWheel<T, SlotNum, Container>::Start() {
 	while (!stop.load()) {
 		sleep(1);
-		for (auto &task : slots.at(times % SlotNum)) {
+		Container<T> due;
+		{
+			std::scoped_lock<std::mutex> lock(mutex);
+			due.swap(slots.at(times % SlotNum));
+			++times;
+		}
+		for (auto &task : due) {
 			task.Evict();
 		}
-		slots[times % SlotNum].clear();
-		++times;
 	}
 }
 
 template <typename T, size_t SlotNum, template <typename> typename Container>
-void TimeWheel<T, SlotNum, Container>::AddTask(T task, size_t interval) {
+bool TimeWheel<T, SlotNum, Container>::AddTask(T task, size_t interval) {
 	if (interval > SlotNum)
-		return;
+		return false;
+	std::scoped_lock<std::mutex> lock(mutex);
 	auto slot_index = (times + interval - 1) % SlotNum;
 	slots[slot_index].push_back(task);
+	return true;
 }